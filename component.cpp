@@ -0,0 +1,552 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cerrno>
+#include <chrono>
+#include <unordered_map>
+#include <rtxi/rtos.hpp>
+#include "component.hpp"
+
+// how long exportCoefficients() waits for a tick before saving without state
+constexpr auto SNAPSHOT_WAIT = std::chrono::milliseconds(200);
+// a stream's ring holds this much of the signal, for the writer to fall behind by
+constexpr uint64_t STREAM_BUFFER_NS = 500000000;
+constexpr size_t STREAM_MIN_FRAMES = 1024;
+// auto-order searches remembered by the design thread
+constexpr size_t MAX_ORDER_CHOICES = 16;
+
+namespace {
+
+// timeImplementations() runs every implementation and precision unquantized,
+// so only the rest of the spec changes what it measures
+FilterSpec timingKey(const FilterSpec& spec)
+{
+	FilterSpec key = spec;
+	key.quant_enabled = false;
+	key.input_quan_factor = 0;
+	key.coeff_quan_factor = 0;
+	key.implementation = 0;
+	key.precision = 0;
+	return key;
+}
+
+// findMinimumOrder() reads the edges, ripples and rate, not how the winner runs
+FilterSpec searchKey(const FilterSpec& spec)
+{
+	FilterSpec key = canonicalSpec(spec);
+	key.quant_enabled = false;
+	key.input_quan_factor = 0;
+	key.coeff_quan_factor = 0;
+	key.implementation = 0;
+	key.full_scale = 0;
+	key.precision = 0;
+	return key;
+}
+
+// what a search picked, to be applied to any spec with the same searchKey()
+struct OrderChoice {
+	AutoOrderReport report;
+	int decimation; // the rate the candidates were measured at
+};
+
+} // namespace
+
+IIRfilterComponent::IIRfilterComponent(Widgets::Plugin* host_plugin, size_t channels) 
+	: Widgets::Component(host_plugin, "IIR Filter", get_default_channels(channels), get_default_vars()),
+	num_channels(channels), input_buffer(channels, 0.0), output_buffer(channels, 0.0),
+	fade_buffer(channels, 0.0)
+{
+	ns_per_tick = CycleClock::nsPerTick(); // calibrates here, not on the real-time thread
+	period_ns = static_cast<uint64_t>(RT::OS::getPeriod());
+	sem_init(&design_wakeup, 0, 0);
+	design_thread = std::thread(&IIRfilterComponent::designLoop, this);
+	initParameters();
+}
+
+IIRfilterComponent::~IIRfilterComponent()
+{
+	stopStream();
+	{
+		std::unique_lock<std::mutex> lock(design_mutex);
+		design_quit = true;
+	}
+	wakeDesigner();
+	design_thread.join();
+	sem_destroy(&design_wakeup);
+	delete pending_filter.exchange(nullptr);
+	delete retired_filter.exchange(nullptr);
+	delete fading_filter;
+	delete active_filter;
+}
+				
+//execute, the code block that actually does the signal processing
+void IIRfilterComponent::execute() {
+	const uint64_t start = CycleClock::now();
+	const ScopedFlushToZero flush_to_zero; // subnormal state would make ticks slow
+	switch (this->getState()) {
+		case RT::State::EXEC:
+			adoptFilter();
+			filterChannels();
+			recordLatency(exec_latency, start);
+			break;
+		case RT::State::INIT:
+			readParameters();
+			// adopt before requesting: a design published between the two
+			// would otherwise be taken up on this tick or the next by chance
+			adoptFilter();
+			requestFilter();
+			filterChannels();
+			this->setState(RT::State::EXEC);
+			recordLatency(init_latency, start);
+			break;
+		case RT::State::MODIFY:
+			readParameters();
+			adoptFilter();
+			requestFilter();
+			filterChannels();
+			// a live retune keeps the output going; the new design crossfades in
+			this->setState(live_retune ? RT::State::EXEC : RT::State::PAUSE);
+			recordLatency(modify_latency, start);
+			break;
+		case RT::State::PAUSE:
+			writeZero(); // stop command in case pause occurs in the middle of command
+			break;
+		case RT::State::UNPAUSE:
+			this->setState(RT::State::EXEC);
+			writeZero();
+			break;
+		case RT::State::PERIOD:
+			spec.dt = RT::OS::getPeriod() * 1e-9; // s
+			period_ns = static_cast<uint64_t>(RT::OS::getPeriod());
+			requestFilter(); // bilinear transform depends on the period
+			this->setState(RT::State::EXEC);
+			break;
+		default:
+			break;
+	}
+}
+
+void IIRfilterComponent::recordLatency(LatencyHistogram& histogram, uint64_t start) {
+	const auto ns = static_cast<uint64_t>(static_cast<double>(CycleClock::now() - start) * ns_per_tick);
+	histogram.record(ns, ns > period_ns);
+}
+
+LatencyReport IIRfilterComponent::getLatency() const
+{
+	return {exec_latency.snapshot(), modify_latency.snapshot(), init_latency.snapshot()};
+}
+
+HealthReport IIRfilterComponent::getHealth() const
+{
+	return {health_resets.load(std::memory_order_relaxed), health_rebuilds.load(std::memory_order_relaxed),
+		ScopedFlushToZero::supported()};
+}
+
+AutoOrderReport IIRfilterComponent::getAutoOrder()
+{
+	std::unique_lock<std::mutex> lock(design_mutex);
+	return auto_order_report;
+}
+
+std::vector<ImplementationTiming> IIRfilterComponent::getTiming()
+{
+	std::unique_lock<std::mutex> lock(design_mutex);
+	return latest_timing;
+}
+
+precision_t IIRfilterComponent::getPrecision()
+{
+	std::unique_lock<std::mutex> lock(design_mutex);
+	return latest_precision;
+}
+
+std::shared_ptr<const FrequencyResponse> IIRfilterComponent::getResponse()
+{
+	std::unique_lock<std::mutex> lock(design_mutex);
+	return latest_response;
+}
+
+CoefficientFile IIRfilterComponent::exportCoefficients(bool with_state)
+{
+	CoefficientFile file;
+	{
+		std::unique_lock<std::mutex> lock(design_mutex);
+		file.spec = latest_spec;
+		file.design = latest_design;
+	}
+	if (!with_state || file.design == nullptr) { return file; }
+
+	StateSnapshot snapshot{file.design.get(), std::vector<double>(2 * file.design->sections.size() * num_channels), false};
+	snapshot_request.store(&snapshot, std::memory_order_release);
+	const auto deadline = std::chrono::steady_clock::now() + SNAPSHOT_WAIT;
+	while (snapshot_done.load(std::memory_order_acquire) != &snapshot && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	// not ticking (paused, say): withdraw the request, unless it was taken
+	// just now, in which case the answer is moments away
+	if (snapshot_request.exchange(nullptr, std::memory_order_acq_rel) == &snapshot) { return file; }
+	while (snapshot_done.load(std::memory_order_acquire) != &snapshot) { std::this_thread::yield(); }
+	snapshot_done.store(nullptr, std::memory_order_relaxed);
+	if (snapshot.taken) {
+		file.state_channels = num_channels;
+		file.state = std::move(snapshot.state);
+	}
+	return file;
+}
+
+void IIRfilterComponent::installCoefficients(CoefficientFile file)
+{
+	std::unique_lock<std::mutex> lock(design_mutex);
+	loaded_file = std::make_unique<CoefficientFile>(std::move(file));
+	wakeDesigner();
+}
+
+bool IIRfilterComponent::startStream(const std::string& path, std::string& error)
+{
+	stopStream();
+	const auto period = std::max<uint64_t>(static_cast<uint64_t>(RT::OS::getPeriod()), 1);
+	auto sink = std::make_unique<StreamSink>(num_channels,
+		std::max<size_t>(STREAM_BUFFER_NS / period, STREAM_MIN_FRAMES));
+	if (!sink->open(path, error)) { return false; }
+	std::unique_lock<std::mutex> lock(stream_mutex);
+	stream_sink.store(sink.get(), std::memory_order_seq_cst);
+	stream_owner = std::move(sink);
+	return true;
+}
+
+void IIRfilterComponent::stopStream()
+{
+	std::unique_lock<std::mutex> lock(stream_mutex);
+	if (stream_owner == nullptr) { return; }
+	stream_sink.store(nullptr, std::memory_order_seq_cst);
+	// a tick that loaded the sink before it was withdrawn is still pushing
+	while (stream_in_use.load(std::memory_order_seq_cst)) { std::this_thread::yield(); }
+	stream_owner.reset();
+}
+
+StreamReport IIRfilterComponent::getStream() const
+{
+	std::unique_lock<std::mutex> lock(stream_mutex);
+	StreamReport report;
+	if (stream_owner == nullptr) { return report; }
+	report.active = true;
+	report.path = stream_owner->getPath();
+	report.frames_written = stream_owner->framesWritten();
+	report.frames_dropped = stream_owner->framesDropped();
+	report.error = stream_owner->getError();
+	return report;
+}
+
+bool IIRfilterComponent::designSettled() const
+{
+	return designed.load(std::memory_order_acquire) == requests.load(std::memory_order_acquire)
+		&& retired_filter.load(std::memory_order_acquire) == nullptr
+		&& rebuilt.load(std::memory_order_acquire) == rebuild_requests.load(std::memory_order_acquire);
+}
+
+std::vector<double> IIRfilterComponent::getNumeratorCoefficients()
+{
+	std::unique_lock<std::mutex> lock(design_mutex);
+	if (latest_design == nullptr) { return {}; }
+	return latest_design->numer_coeff;
+}
+
+std::vector<double> IIRfilterComponent::getDenominatorCoefficients()
+{
+	std::unique_lock<std::mutex> lock(design_mutex);
+	if (latest_design == nullptr) { return {}; }
+	return latest_design->denom_coeff;
+}
+
+// custom functions, as defined in the header file
+void IIRfilterComponent::initParameters() {
+	spec.dt = RT::OS::getPeriod() * 1e-9; // s
+	spec.filter_type = BUTTER;
+	spec.filter_order = 10;
+	spec.passband_ripple = 3;
+	spec.passband_edge = 60;
+	spec.stopband_ripple = 60;
+	spec.stopband_edge = 200;
+	spec.ripple_bw_norm = 0;
+	spec.predistort_enabled = true;
+	spec.quant_enabled = false;
+	spec.input_quan_factor = 4096; // quantize input to 12 bits
+	spec.coeff_quan_factor = 4096; // quantize filter coefficients to 12 bits
+	spec.implementation = SECTIONS;
+	spec.full_scale = 10;
+	spec.notch_frequency = 60;
+	spec.notch_harmonics = 5;
+	spec.notch_q = 30;
+	spec.auto_order = false;
+	spec.multirate = false;
+	spec.decimation = 0;
+	spec.interpolate = true;
+	spec.precision = DOUBLE_PRECISION;
+	live_retune = false;
+	crossfade_ticks = 64;
+	requestFilter();
+}
+
+void IIRfilterComponent::readParameters() {
+	spec.filter_order = getValue<int64_t>(FILTER_ORDER);
+	spec.passband_ripple = getValue<double>(PASSBAND_RIPPLE);
+	spec.passband_edge = getValue<double>(PASSBAND_EDGE);
+	spec.stopband_ripple = getValue<double>(STOPBAND_RIPPLE);
+	spec.stopband_edge = getValue<double>(STOPBAND_EDGE);
+	spec.filter_type = getValue<uint64_t>(FILTER_TYPE);
+	spec.input_quan_factor = quantization_factor(getValue<int64_t>(INPUT_QUANTIZING_FACTOR));
+	spec.coeff_quan_factor = quantization_factor(getValue<int64_t>(COEFF_QUANTIZING_FACTOR));
+	spec.ripple_bw_norm = getValue<uint64_t>(CHEBYSHEV_NORM_TYPE);
+	spec.predistort_enabled = getValue<uint64_t>(PREDISTORT) == 1;
+	spec.quant_enabled = getValue<uint64_t>(QUANTIZE) == 1;
+	spec.implementation = getValue<uint64_t>(IMPLEMENTATION);
+	spec.full_scale = getValue<double>(FULL_SCALE);
+	spec.notch_frequency = getValue<double>(NOTCH_FREQUENCY);
+	spec.notch_harmonics = static_cast<int>(std::max<int64_t>(getValue<int64_t>(NOTCH_HARMONICS), 0));
+	spec.notch_q = getValue<double>(NOTCH_Q);
+	spec.auto_order = getValue<uint64_t>(AUTO_ORDER) == 1;
+	spec.multirate = getValue<uint64_t>(MULTIRATE) == 1;
+	spec.decimation = static_cast<int>(std::clamp<int64_t>(getValue<int64_t>(DECIMATION), 0, MAX_DECIMATION));
+	spec.interpolate = getValue<uint64_t>(INTERPOLATE) == 1;
+	spec.precision = std::min<uint64_t>(getValue<uint64_t>(PRECISION), AUTO_PRECISION);
+	live_retune = getValue<uint64_t>(LIVE_RETUNE) == 1;
+	crossfade_ticks = static_cast<size_t>(std::max<int64_t>(getValue<int64_t>(CROSSFADE_TICKS), 0));
+}
+
+// Hand the current spec to the design thread. Never blocks, safe to call from
+// the real-time thread; only the most recent request is designed.
+// Specs that differ only in parameters the filter ignores are not redesigned.
+void IIRfilterComponent::requestFilter() {
+	const FilterSpec canonical = canonicalSpec(spec);
+	if (has_requested && canonical == last_requested) { return; }
+	requested_spec.write(canonical);
+	last_requested = canonical;
+	has_requested = true;
+	requests.store(requests.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	wakeDesigner();
+}
+
+// Swap in a freshly designed filter if one is waiting. Real-time safe: no
+// allocation, no locks. The replaced filter is left for the design thread to
+// delete, and we hold off adopting again until it has done so.
+// On a live retune the new filter starts from the steady state of the last
+// input and the old one keeps running until the crossfade is over.
+void IIRfilterComponent::adoptFilter() {
+	if (fading_filter != nullptr) { return; }
+	if (retired_filter.load(std::memory_order_acquire) != nullptr) { return; }
+	FilterBlock* fresh = pending_filter.exchange(nullptr, std::memory_order_acq_rel);
+	if (fresh == nullptr) { return; }
+	// nothing to fade from if the old filter has been muted
+	if (live_retune && crossfade_ticks > 0 && active_filter != nullptr && !muted) {
+		fresh->setSteadyState(input_buffer.data());
+		fading_filter = active_filter;
+		fade_tick = 0;
+		fade_length = crossfade_ticks;
+	}
+	else {
+		retired_filter.store(active_filter, std::memory_order_release);
+		wakeDesigner();
+	}
+	active_filter = fresh;
+	muted = false;
+}
+
+// output stays at zero until the first design has been adopted
+void IIRfilterComponent::filterChannels() {
+	if (active_filter == nullptr || muted) {
+		writeZero();
+		return;
+	}
+	for (size_t i = 0; i < num_channels; i++) { input_buffer[i] = readinput(i); }
+	active_filter->process(input_buffer.data(), output_buffer.data());
+	if (snapshot_request.load(std::memory_order_relaxed) != nullptr) { takeSnapshot(); }
+	if (fading_filter != nullptr) {
+		// linear crossfade; at most two filters run per tick
+		fading_filter->process(input_buffer.data(), fade_buffer.data());
+		fade_tick++;
+		const double weight = static_cast<double>(fade_tick) / static_cast<double>(fade_length + 1);
+		for (size_t i = 0; i < num_channels; i++) {
+			output_buffer[i] = weight * output_buffer[i] + (1 - weight) * fade_buffer[i];
+		}
+		if (fade_tick >= fade_length) {
+			retired_filter.store(fading_filter, std::memory_order_release);
+			wakeDesigner();
+			fading_filter = nullptr;
+		}
+	}
+	if (!isHealthy(output_buffer.data(), num_channels)) { recoverFilter(); }
+	for (size_t i = 0; i < num_channels; i++) { writeoutput(i, output_buffer[i]); }
+	streamFrame();
+}
+
+// Hand the tick's inputs and outputs to the stream, if there is one. Real-time
+// safe: StreamSink::push() only copies into its ring, or drops the frame.
+void IIRfilterComponent::streamFrame() {
+	if (stream_sink.load(std::memory_order_relaxed) == nullptr) { return; }
+	stream_in_use.store(true, std::memory_order_seq_cst);
+	if (StreamSink* sink = stream_sink.load(std::memory_order_seq_cst)) {
+		sink->push(input_buffer.data(), output_buffer.data());
+	}
+	stream_in_use.store(false, std::memory_order_release);
+}
+
+// A NaN, infinity or runaway value came out. Real-time safe: the state is
+// cleared in place, or if the implementation cannot do that, the output is
+// muted until the design thread has rebuilt the filter. Either way this
+// tick's output is zero and any crossfade is abandoned.
+void IIRfilterComponent::recoverFilter() {
+	if (fading_filter != nullptr) {
+		retired_filter.store(fading_filter, std::memory_order_release);
+		wakeDesigner();
+		fading_filter = nullptr;
+	}
+	if (active_filter->recover(input_buffer.data())) {
+		health_resets.store(health_resets.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	} else {
+		muted = true;
+		rebuild_requests.store(rebuild_requests.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		wakeDesigner();
+		health_rebuilds.store(health_rebuilds.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+	std::fill(output_buffer.begin(), output_buffer.end(), 0.0);
+}
+
+// Copy the running sections' state into the buffer exportCoefficients() is
+// waiting on. Real-time safe: the buffer was sized by the caller. Nothing is
+// captured mid-crossfade, or unless the design asked about is running as
+// plain sections.
+void IIRfilterComponent::takeSnapshot() {
+	StateSnapshot* snapshot = snapshot_request.exchange(nullptr, std::memory_order_acq_rel);
+	if (snapshot == nullptr) { return; }
+	snapshot->taken = fading_filter == nullptr && active_filter->design.get() == snapshot->design
+		&& active_filter->plainSections();
+	if (snapshot->taken) { active_filter->sections.getState(snapshot->state.data()); }
+	snapshot_done.store(snapshot, std::memory_order_release);
+}
+
+void IIRfilterComponent::writeZero() {
+	for (size_t i = 0; i < num_channels; i++) { writeoutput(i, 0); }
+}
+
+// Tell the design thread there is something to do: a request, a rebuild, a
+// retired filter, a loaded file or quitting. Real-time safe.
+void IIRfilterComponent::wakeDesigner() {
+	sem_post(&design_wakeup);
+}
+
+// Non real-time worker: designs requested filters, publishes them to the
+// real-time thread and reclaims the ones it has stopped using.
+void IIRfilterComponent::designLoop() {
+	FilterSpec next{};
+	FilterSpec built{}; // what the last block was made from, for rebuilds
+	std::shared_ptr<const FilterDesign> built_design;
+	std::unique_ptr<CoefficientFile> restore; // loaded state for the first block built for its spec
+	FilterSpec timed{}; // the timingKey() and design latest_timing was measured for
+	std::shared_ptr<const FilterDesign> timed_design;
+	std::unordered_map<FilterSpec, OrderChoice, FilterSpecHash> order_choices; // by searchKey()
+	while (true) {
+		// sleep until woken; wakeups that arrived meanwhile are all served by
+		// this one pass, which reads everything after taking them
+		while (sem_wait(&design_wakeup) != 0 && errno == EINTR) {}
+		while (sem_trywait(&design_wakeup) == 0) {}
+		std::unique_ptr<CoefficientFile> loaded;
+		{
+			std::unique_lock<std::mutex> lock(design_mutex);
+			if (design_quit) { break; }
+			loaded = std::move(loaded_file);
+		}
+		if (loaded != nullptr) {
+			// before reading the request for it, so that it is a cache hit
+			design_cache.insert(loaded->spec, loaded->design);
+			restore = loaded->state.empty() ? nullptr : std::move(loaded);
+		}
+		delete retired_filter.exchange(nullptr, std::memory_order_acq_rel);
+		const uint64_t rebuilds = rebuild_requests.load(std::memory_order_acquire);
+		const bool rebuild = rebuilds != rebuilt.load(std::memory_order_relaxed);
+		// every request counted here is in the buffer by the time it is read
+		const uint64_t seen = requests.load(std::memory_order_acquire);
+		if (!requested_spec.read(next)) {
+			// the same filter with fresh state, for one that could not recover
+			if (rebuild && built_design != nullptr) {
+				delete pending_filter.exchange(makeFilter(built_design, built, num_channels).release(),
+					std::memory_order_acq_rel);
+			}
+			designed.store(seen, std::memory_order_release);
+			rebuilt.store(rebuilds, std::memory_order_release);
+			continue;
+		}
+
+		std::unique_ptr<FilterBlock> block;
+		AutoOrderReport report;
+		if (next.auto_order) {
+			// search once per mask; the winner is then designed like any other spec
+			const FilterSpec key = searchKey(next);
+			auto choice = order_choices.find(key);
+			if (choice == order_choices.end()) {
+				const OrderSearchResult search = findMinimumOrder(next);
+				if (order_choices.size() >= MAX_ORDER_CHOICES) { order_choices.clear(); }
+				const AutoOrderReport found{true, search.spec.filter_type, search.spec.filter_order, search.meets_spec};
+				choice = order_choices.emplace(key, OrderChoice{found, search.spec.decimation}).first;
+			}
+			report = choice->second.report;
+			built = next;
+			built.auto_order = false;
+			built.filter_type = report.filter_type;
+			built.filter_order = report.filter_order;
+			built.decimation = choice->second.decimation;
+			block = makeFilter(design_cache.get(built), built, num_channels);
+		} else {
+			block = makeFilter(design_cache.get(next), next, num_channels);
+			built = next;
+			if (restore != nullptr && restore->spec == next && block->plainSections()
+				&& restore->state_channels == num_channels && block->design == restore->design) {
+				block->sections.setState(restore->state.data());
+				restore.reset();
+			}
+		}
+		built_design = block->design;
+		{
+			std::unique_lock<std::mutex> lock(design_mutex);
+			latest_design = block->design;
+			latest_spec = built;
+			auto_order_report = report;
+			latest_precision = built.precision == AUTO_PRECISION
+				? choosePrecision(block->design->sections) : static_cast<precision_t>(built.precision);
+		}
+		// a design the real-time thread never picked up can go straight away
+		delete pending_filter.exchange(block.release(), std::memory_order_acq_rel);
+		designed.store(seen, std::memory_order_release);
+		rebuilt.store(rebuilds, std::memory_order_release);
+
+		// the response and timing are only for the panel, so the filter does not
+		// wait for them; switching implementation or precision keeps the timing
+		auto response = std::make_shared<const FrequencyResponse>(computeResponse(built_design->sections, decimatedSpec(next).dt));
+		const bool retime = built_design != timed_design || timingKey(built) != timed;
+		std::vector<ImplementationTiming> timing;
+		if (retime) {
+			timing = timeImplementations(built_design, built, num_channels);
+			timed = timingKey(built);
+			timed_design = built_design;
+		}
+		{
+			std::unique_lock<std::mutex> lock(design_mutex);
+			latest_response = std::move(response);
+			if (retime) { latest_timing = std::move(timing); }
+		}
+	}
+}
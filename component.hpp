@@ -0,0 +1,289 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* IIRfilterComponent
+* The real-time side of the plugin: reads the parameters, hands specs to a
+* design thread, adopts the filters it builds and runs them on every tick.
+* Only RTXI's Component is needed, no Qt, so the replay harness
+* (tools/replay.cpp) can drive it against a stand-in for RTXI.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <semaphore.h>
+#include <rtxi/widgets.hpp>
+#include "dsp/coefficient-file.hpp"
+#include "dsp/design-cache.hpp"
+#include "dsp/design-store.hpp"
+#include "dsp/filter-design.hpp"
+#include "dsp/implementation-timing.hpp"
+#include "dsp/numeric-health.hpp"
+#include "dsp/order-search.hpp"
+#include "dsp/response.hpp"
+#include "latency-histogram.hpp"
+#include "stream-sink.hpp"
+#include "triple-buffer.hpp"
+
+// number of input/output pairs filtered by one component, all sharing the
+// same design; set at configure time with -DIIR_FILTER_CHANNELS=n
+#ifndef IIR_FILTER_CHANNELS
+#define IIR_FILTER_CHANNELS 1
+#endif
+
+// what the automatic order search settled on
+struct AutoOrderReport {
+	bool searched = false; // false until an auto-order design has been made
+	uint64_t filter_type = BUTTER;
+	int filter_order = 0;
+	bool meets_spec = false;
+};
+
+// time spent in execute(), per state
+struct LatencyReport {
+	LatencyHistogram::Snapshot exec;
+	LatencyHistogram::Snapshot modify;
+	LatencyHistogram::Snapshot init;
+};
+
+// filters found producing NaN, infinity or runaway values, and what was done
+struct HealthReport {
+	uint64_t resets = 0; // state cleared in place
+	uint64_t rebuilds = 0; // muted until the design thread rebuilt the filter
+	bool flush_to_zero = false; // subnormals flushed on the real-time thread
+};
+
+// the input/output tap to disk, if one is running
+struct StreamReport {
+	bool active = false;
+	std::string path;
+	uint64_t frames_written = 0;
+	uint64_t frames_dropped = 0; // ring full or write failed
+	std::string error; // the write that failed, if any
+};
+
+enum PARAMETER : Widgets::Variable::Id
+{
+	FILTER_ORDER=0,
+	PASSBAND_RIPPLE,
+	PASSBAND_EDGE,
+	STOPBAND_RIPPLE,
+	STOPBAND_EDGE,
+	INPUT_QUANTIZING_FACTOR,
+	COEFF_QUANTIZING_FACTOR,
+	FILTER_TYPE,
+	CHEBYSHEV_NORM_TYPE,
+	PREDISTORT,
+	QUANTIZE,
+	IMPLEMENTATION,
+	FULL_SCALE,
+	LIVE_RETUNE,
+	CROSSFADE_TICKS,
+	AUTO_ORDER,
+	NOTCH_FREQUENCY,
+	NOTCH_HARMONICS,
+	NOTCH_Q,
+	MULTIRATE,
+	DECIMATION,
+	INTERPOLATE,
+	PRECISION
+};
+
+inline std::vector<Widgets::Variable::Info> get_default_vars()
+{
+//set up parameters, calls for initialization, creation, update, and refresh of GUI
+	return {
+		{FILTER_ORDER,           "Filter Order", "Filter Order", Widgets::Variable::INT_PARAMETER, int64_t{10}},
+		{PASSBAND_RIPPLE,        "Passband Ripple (dB)", "Passband Ripple (dB)", Widgets::Variable::DOUBLE_PARAMETER, 3.0},
+		{PASSBAND_EDGE,          "Passband Edge (Hz)", "Passband Edge (Hz)", Widgets::Variable::DOUBLE_PARAMETER, 60.0},
+		{STOPBAND_RIPPLE,        "Stopband Ripple (dB)", "Stopband Ripple (dB)", Widgets::Variable::DOUBLE_PARAMETER, 60.0},
+		{STOPBAND_EDGE,          "Stopband Edge (Hz)", "Stopband Edge (Hz)", Widgets::Variable::DOUBLE_PARAMETER, 200.0},
+		{INPUT_QUANTIZING_FACTOR,"Input quantizing factor", "Bits eg. 10, 12, 16", Widgets::Variable::INT_PARAMETER, int64_t{12}},
+		{COEFF_QUANTIZING_FACTOR,"Coefficients quantizing factor", "Bits eg. 10, 12, 16", Widgets::Variable::INT_PARAMETER, int64_t{12}},
+		{FILTER_TYPE,		 "Type of filter to implement", "Butterworth, Chebyshev, Elliptical", Widgets::Variable::UINT_PARAMETER, uint64_t{0}},
+		{CHEBYSHEV_NORM_TYPE,	 "Chebyshev normalization type", "", Widgets::Variable::UINT_PARAMETER, uint64_t{0}},
+		{PREDISTORT,	 "Pre-Distort Signal", "", Widgets::Variable::UINT_PARAMETER, uint64_t{1}},
+		{QUANTIZE,	 "Use Quantization Mode", "", Widgets::Variable::UINT_PARAMETER, uint64_t{0}},
+		{IMPLEMENTATION,	 "Filter implementation", "Second-order sections, Direct form, Fixed-point Q15, Fixed-point Q31, Direct form I sections, Lattice-ladder, State variable", Widgets::Variable::UINT_PARAMETER, uint64_t{SECTIONS}},
+		{FULL_SCALE,	 "Fixed-point full scale", "Input amplitude mapped to fixed-point full scale", Widgets::Variable::DOUBLE_PARAMETER, 10.0},
+		{LIVE_RETUNE,	 "Retune without pausing", "Keep filtering through parameter changes", Widgets::Variable::UINT_PARAMETER, uint64_t{0}},
+		{CROSSFADE_TICKS,	 "Crossfade ticks", "Ticks over which a live retune fades to the new filter", Widgets::Variable::INT_PARAMETER, int64_t{64}},
+		{AUTO_ORDER,	 "Automatic order", "Pick the cheapest type and order that meet the edges and ripples", Widgets::Variable::UINT_PARAMETER, uint64_t{0}},
+		{NOTCH_FREQUENCY,	 "Notch Frequency (Hz)", "Fundamental of the harmonic notch, e.g. mains", Widgets::Variable::DOUBLE_PARAMETER, 60.0},
+		{NOTCH_HARMONICS,	 "Notch Harmonics", "Number of notches, at 1, 2, 3... times the fundamental", Widgets::Variable::INT_PARAMETER, int64_t{5}},
+		{NOTCH_Q,	 "Notch Q", "Center frequency over -3 dB bandwidth of each notch", Widgets::Variable::DOUBLE_PARAMETER, 30.0},
+		{MULTIRATE,	 "Multirate", "Run the filter at a rate decimated to suit the cutoff", Widgets::Variable::UINT_PARAMETER, uint64_t{0}},
+		{DECIMATION,	 "Decimation factor", "Ticks per filter step when multirate, 0 to pick one from the cutoff", Widgets::Variable::INT_PARAMETER, int64_t{0}},
+		{INTERPOLATE,	 "Interpolate", "Interpolate the multirate output back to every tick rather than hold it", Widgets::Variable::UINT_PARAMETER, uint64_t{1}},
+		{PRECISION,	 "Precision", "Double, Single, Mixed (float state, double arithmetic), Automatic", Widgets::Variable::UINT_PARAMETER, uint64_t{DOUBLE_PRECISION}}
+	};
+}
+
+inline std::vector<IO::channel_t> get_default_channels(size_t channels)
+{
+//set up inputs/outputs, calls for initialization, creation, update, and refresh of GUI
+	if (channels == 1) {
+		return {
+			{ "Input", "Input to Filter", IO::INPUT, },
+			{ "Output", "Output of Filter", IO::OUTPUT }
+		};
+	}
+	// all inputs first, then all outputs, so channel i is input(i) -> output(i)
+	std::vector<IO::channel_t> result;
+	for (size_t i = 0; i < channels; i++) {
+		result.push_back({ "Input " + std::to_string(i), "Input to Filter", IO::INPUT });
+	}
+	for (size_t i = 0; i < channels; i++) {
+		result.push_back({ "Output " + std::to_string(i), "Output of Filter", IO::OUTPUT });
+	}
+	return result;
+}
+
+class IIRfilterComponent : public Widgets::Component{
+	public:
+		IIRfilterComponent(Widgets::Plugin* host_plugin, size_t channels);
+		~IIRfilterComponent() override;
+		IIRfilterComponent(const IIRfilterComponent&) = delete;
+		IIRfilterComponent& operator=(const IIRfilterComponent&) = delete;
+		IIRfilterComponent(IIRfilterComponent&&) = delete;
+		IIRfilterComponent& operator=(IIRfilterComponent&&) = delete;
+		void execute() override;
+		std::vector<double> getNumeratorCoefficients();
+		std::vector<double> getDenominatorCoefficients();
+		LatencyReport getLatency() const;
+		HealthReport getHealth() const;
+		AutoOrderReport getAutoOrder();
+		std::shared_ptr<const FrequencyResponse> getResponse();
+		std::vector<ImplementationTiming> getTiming();
+		precision_t getPrecision(); // what the latest design runs in, AUTO_PRECISION resolved
+		// the filter as last built, with the running state if with_state and
+		// the real-time thread can capture it
+		CoefficientFile exportCoefficients(bool with_state);
+		// make file's design the cached design for its spec, so that the next
+		// request for that spec builds straight from it (with its state)
+		void installCoefficients(CoefficientFile file);
+		// Tap every tick's inputs and outputs to path (see stream-sink.hpp),
+		// replacing any tap already running. On failure returns false with a
+		// reason in error.
+		bool startStream(const std::string& path, std::string& error);
+		// stop the tap once the real-time thread has let go of it, writing out
+		// everything it pushed
+		void stopStream();
+		StreamReport getStream() const;
+		// True once the design thread owes the real-time thread nothing: every
+		// request designed and published, the replaced filter reclaimed and no
+		// rebuild outstanding. Waiting for it before each tick makes a replay
+		// independent of how fast the design thread runs; the plugin never does.
+		bool designSettled() const;
+	private:
+		// filter parameters
+		FilterSpec spec{};
+
+		// bookkeeping
+		size_t num_channels; // inputs, and as many outputs
+		std::vector<double> input_buffer; // one sample per channel
+		std::vector<double> output_buffer;
+		std::vector<double> fade_buffer; // output of the outgoing filter
+
+		// real-time side of the filter handoff
+		FilterBlock* active_filter=nullptr; // owned by the real-time thread
+		std::atomic<FilterBlock*> pending_filter{nullptr}; // designed, not yet adopted
+		std::atomic<FilterBlock*> retired_filter{nullptr}; // replaced, not yet reclaimed
+		TripleBuffer<FilterSpec> requested_spec;
+		FilterSpec last_requested{}; // canonical form of the last request
+		bool has_requested=false;
+		std::atomic<uint64_t> requests{0}; // specs handed over, written by the real-time thread
+		std::atomic<uint64_t> designed{0}; // of those, published by the design thread
+
+		// live retuning: the outgoing filter keeps running while the output
+		// crossfades to the new one
+		bool live_retune=false;
+		size_t crossfade_ticks=0;
+		FilterBlock* fading_filter=nullptr; // owned by the real-time thread
+		size_t fade_tick=0;
+		size_t fade_length=0; // crossfade_ticks when the fade began
+
+		// numerical health: faults are counted by the real-time thread only
+		bool muted=false; // active_filter could not recover, waiting for a rebuild
+		std::atomic<uint64_t> rebuild_requests{0}; // written by the real-time thread
+		std::atomic<uint64_t> rebuilt{0}; // of those, published by the design thread
+		std::atomic<uint64_t> health_resets{0};
+		std::atomic<uint64_t> health_rebuilds{0};
+
+		// design thread
+		std::thread design_thread;
+		std::mutex design_mutex;
+		// posted whenever there is work for the design thread, which sleeps on
+		// it otherwise; sem_post() never blocks, so the real-time thread can too
+		sem_t design_wakeup;
+		bool design_quit=false;
+		DesignStore design_store{DesignStore::defaultDirectory()}; // designs kept across sessions
+		DesignCache design_cache{16, &design_store}; // only touched by the design thread
+		std::shared_ptr<const FilterDesign> latest_design; // guarded by design_mutex
+		AutoOrderReport auto_order_report; // guarded by design_mutex
+		std::shared_ptr<const FrequencyResponse> latest_response; // guarded by design_mutex
+		std::vector<ImplementationTiming> latest_timing; // guarded by design_mutex
+		FilterSpec latest_spec{}; // what latest_design was built for, guarded by design_mutex
+		precision_t latest_precision=DOUBLE_PRECISION; // guarded by design_mutex
+		std::unique_ptr<CoefficientFile> loaded_file; // guarded by design_mutex until the design thread takes it
+
+		// state capture for exportCoefficients(): the caller's buffer is filled
+		// by the real-time thread on its next tick
+		struct StateSnapshot {
+			const FilterDesign* design; // only taken while this design is running
+			std::vector<double> state; // preallocated by the caller
+			bool taken;
+		};
+		std::atomic<StateSnapshot*> snapshot_request{nullptr};
+		std::atomic<StateSnapshot*> snapshot_done{nullptr};
+
+		// streaming to disk: the real-time thread marks itself in stream_in_use
+		// before loading stream_sink, so stopStream() can tell when it is done
+		std::atomic<StreamSink*> stream_sink{nullptr};
+		std::atomic<bool> stream_in_use{false};
+		std::unique_ptr<StreamSink> stream_owner; // guarded by stream_mutex
+		mutable std::mutex stream_mutex;
+
+		// execute() timing, written by the real-time thread only
+		LatencyHistogram exec_latency;
+		LatencyHistogram modify_latency;
+		LatencyHistogram init_latency;
+		double ns_per_tick; // CycleClock calibration
+		uint64_t period_ns; // longer ticks count as overruns
+
+		// IIRfilter functions
+		void initParameters();
+		void readParameters();
+		void requestFilter();
+		void adoptFilter();
+		void filterChannels();
+		void recoverFilter();
+		void takeSnapshot();
+		void streamFrame();
+		void writeZero();
+		void wakeDesigner();
+		void designLoop();
+		void recordLatency(LatencyHistogram& histogram, uint64_t start);
+};
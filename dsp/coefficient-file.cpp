@@ -0,0 +1,533 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "coefficient-file.hpp"
+
+namespace {
+
+constexpr char BINARY_MAGIC[8] = {'I', 'I', 'R', 'C', 'O', 'E', 'F', '\0'};
+constexpr char TEXT_MAGIC[] = "# iir-filter sos ";
+constexpr uint32_t FLAG_STATE = 1;
+
+// Every FilterSpec field, in file order. Both formats are driven from this
+// table, so a field added to FilterSpec only needs a line here, at the end,
+// with a new COEFFICIENT_FILE_VERSION as its since; older files leave it zero.
+enum field_kind_t { UNSIGNED, INTEGER, REAL, FLAG };
+
+struct SpecField {
+	const char* name;
+	field_kind_t kind;
+	size_t offset;
+	uint32_t since; // first format version with the field
+};
+
+#define SPEC_FIELD(field, kind) {#field, kind, offsetof(FilterSpec, field), 1}
+#define SPEC_FIELD_SINCE(field, kind, version) {#field, kind, offsetof(FilterSpec, field), version}
+const SpecField SPEC_FIELDS[] = {
+	SPEC_FIELD(filter_type, UNSIGNED),
+	SPEC_FIELD(filter_order, INTEGER),
+	SPEC_FIELD(passband_ripple, REAL),
+	SPEC_FIELD(stopband_ripple, REAL),
+	SPEC_FIELD(passband_edge, REAL),
+	SPEC_FIELD(stopband_edge, REAL),
+	SPEC_FIELD(ripple_bw_norm, INTEGER),
+	SPEC_FIELD(quant_enabled, FLAG),
+	SPEC_FIELD(predistort_enabled, FLAG),
+	SPEC_FIELD(input_quan_factor, INTEGER),
+	SPEC_FIELD(coeff_quan_factor, INTEGER),
+	SPEC_FIELD(implementation, UNSIGNED),
+	SPEC_FIELD(full_scale, REAL),
+	SPEC_FIELD(notch_frequency, REAL),
+	SPEC_FIELD(notch_harmonics, INTEGER),
+	SPEC_FIELD(notch_q, REAL),
+	SPEC_FIELD(dt, REAL),
+	SPEC_FIELD(auto_order, FLAG),
+	SPEC_FIELD(multirate, FLAG),
+	SPEC_FIELD(decimation, INTEGER),
+	SPEC_FIELD(interpolate, FLAG),
+	SPEC_FIELD_SINCE(precision, UNSIGNED, 2),
+};
+#undef SPEC_FIELD
+#undef SPEC_FIELD_SINCE
+
+constexpr size_t NUM_SPEC_FIELDS = sizeof(SPEC_FIELDS) / sizeof(SPEC_FIELDS[0]);
+
+// Fields are read and written through memcpy at their offsets; integers are
+// widened to 64 bits on disk.
+int64_t getInteger(const FilterSpec& spec, const SpecField& field) {
+	const char* at = reinterpret_cast<const char*>(&spec) + field.offset;
+	switch (field.kind) {
+		case UNSIGNED: { uint64_t v; std::memcpy(&v, at, sizeof(v)); return static_cast<int64_t>(v); }
+		case INTEGER: { int v; std::memcpy(&v, at, sizeof(v)); return v; }
+		case FLAG: { bool v; std::memcpy(&v, at, sizeof(v)); return v ? 1 : 0; }
+		default: return 0;
+	}
+}
+
+void setInteger(FilterSpec& spec, const SpecField& field, int64_t value) {
+	char* at = reinterpret_cast<char*>(&spec) + field.offset;
+	switch (field.kind) {
+		case UNSIGNED: { const auto v = static_cast<uint64_t>(value); std::memcpy(at, &v, sizeof(v)); break; }
+		case INTEGER: { const auto v = static_cast<int>(value); std::memcpy(at, &v, sizeof(v)); break; }
+		case FLAG: { const bool v = value != 0; std::memcpy(at, &v, sizeof(v)); break; }
+		default: break;
+	}
+}
+
+double getReal(const FilterSpec& spec, const SpecField& field) {
+	double v;
+	std::memcpy(&v, reinterpret_cast<const char*>(&spec) + field.offset, sizeof(v));
+	return v;
+}
+
+void setReal(FilterSpec& spec, const SpecField& field, double value) {
+	std::memcpy(reinterpret_cast<char*>(&spec) + field.offset, &value, sizeof(value));
+}
+
+uint64_t fnv1a(const unsigned char* data, size_t size) {
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+size_t stateSize(const CoefficientFile& file) {
+	return 2 * file.design->sections.size() * file.state_channels;
+}
+
+bool allFinite(const std::vector<double>& values) {
+	for (double v : values) {
+		if (!std::isfinite(v)) { return false; }
+	}
+	return true;
+}
+
+// What both loaders check before handing a file back.
+bool validate(CoefficientFile& file, std::string& error) {
+	const FilterSpec& spec = file.spec;
+	const FilterDesign& design = *file.design;
+	if (spec.filter_type > NOTCH || spec.implementation > STATE_VARIABLE || spec.precision > AUTO_PRECISION) {
+		error = "unknown filter type, implementation or precision";
+		return false;
+	}
+	if (spec.auto_order) {
+		error = "the spec has to be as built, with the type and order the search chose";
+		return false;
+	}
+	if (!(spec.dt > 0)) {
+		error = "no sampling period";
+		return false;
+	}
+	if (design.numer_coeff.empty() || design.denom_coeff.empty()) {
+		error = "no coefficients";
+		return false;
+	}
+	// no sections is the identity (a notch with every harmonic above Nyquist,
+	// say), and then the direct form has to be 1/1 as well
+	const std::vector<double> one{1.0};
+	if (design.sections.empty() && (design.numer_coeff != one || design.denom_coeff != one)) {
+		error = "no sections for the direct form";
+		return false;
+	}
+	bool finite = allFinite(design.numer_coeff) && allFinite(design.denom_coeff) && allFinite(file.state);
+	for (const Biquad& c : design.sections) {
+		finite = finite && std::isfinite(c.b0) && std::isfinite(c.b1) && std::isfinite(c.b2)
+			&& std::isfinite(c.a1) && std::isfinite(c.a2);
+	}
+	if (!finite) {
+		error = "coefficients or state not finite";
+		return false;
+	}
+	if (file.state.size() != stateSize(file) || (file.state.empty() != (file.state_channels == 0))) {
+		error = "state does not match the sections";
+		return false;
+	}
+	// anything the filter ignores goes back to zero, as canonicalSpec() leaves it
+	file.spec = canonicalSpec(spec);
+	return true;
+}
+
+bool readFile(const std::string& path, std::vector<unsigned char>& bytes, std::string& error) {
+	FILE* f = std::fopen(path.c_str(), "rb");
+	if (f == nullptr) {
+		error = path + ": " + std::strerror(errno);
+		return false;
+	}
+	unsigned char chunk[65536];
+	size_t count;
+	while ((count = std::fread(chunk, 1, sizeof(chunk), f)) > 0) {
+		bytes.insert(bytes.end(), chunk, chunk + count);
+	}
+	const bool failed = std::ferror(f) != 0;
+	std::fclose(f);
+	if (failed) {
+		error = path + ": read error";
+		return false;
+	}
+	return true;
+}
+
+bool writeFile(const std::string& path, const void* data, size_t size, std::string& error) {
+	FILE* f = std::fopen(path.c_str(), "wb");
+	if (f == nullptr) {
+		error = path + ": " + std::strerror(errno);
+		return false;
+	}
+	const bool written = std::fwrite(data, 1, size, f) == size;
+	const bool closed = std::fclose(f) == 0;
+	if (!written || !closed) {
+		error = path + ": write error";
+		return false;
+	}
+	return true;
+}
+
+/*
+* Binary format
+*/
+
+class Writer {
+	public:
+		template<class T>
+		void put(const T& value) {
+			const auto* p = reinterpret_cast<const unsigned char*>(&value);
+			bytes.insert(bytes.end(), p, p + sizeof(T));
+		}
+		void putDoubles(const std::vector<double>& values) {
+			put<uint64_t>(values.size());
+			const auto* p = reinterpret_cast<const unsigned char*>(values.data());
+			bytes.insert(bytes.end(), p, p + values.size() * sizeof(double));
+		}
+		std::vector<unsigned char> bytes;
+};
+
+class Reader {
+	public:
+		Reader(const unsigned char* begin, const unsigned char* end) : at(begin), end(end) {}
+
+		template<class T>
+		T get() {
+			T value{};
+			if (static_cast<size_t>(end - at) < sizeof(T)) {
+				ok = false;
+				return value;
+			}
+			std::memcpy(&value, at, sizeof(T));
+			at += sizeof(T);
+			return value;
+		}
+		void getDoubles(std::vector<double>& values) {
+			const auto count = get<uint64_t>();
+			// a count the rest of the file cannot hold is a corrupt file
+			if (!ok || count > static_cast<size_t>(end - at) / sizeof(double)) {
+				ok = false;
+				return;
+			}
+			values.resize(count);
+			std::memcpy(values.data(), at, count * sizeof(double));
+			at += count * sizeof(double);
+		}
+		bool ok = true;
+
+	private:
+		const unsigned char* at;
+		const unsigned char* end;
+};
+
+void putSpec(Writer& w, const FilterSpec& spec) {
+	for (const SpecField& field : SPEC_FIELDS) {
+		switch (field.kind) {
+			case REAL: w.put<double>(getReal(spec, field)); break;
+			case FLAG: w.put<uint8_t>(static_cast<uint8_t>(getInteger(spec, field))); break;
+			default: w.put<int64_t>(getInteger(spec, field)); break;
+		}
+	}
+}
+
+std::vector<unsigned char> encodeBinary(const CoefficientFile& file) {
+	Writer w;
+	for (char c : BINARY_MAGIC) { w.put(c); }
+	w.put<uint32_t>(COEFFICIENT_FILE_VERSION);
+	w.put<uint32_t>(file.state.empty() ? 0 : FLAG_STATE);
+	putSpec(w, file.spec);
+	const FilterDesign& design = *file.design;
+	w.putDoubles(design.numer_coeff);
+	w.putDoubles(design.denom_coeff);
+	w.put<uint64_t>(design.sections.size());
+	for (const Biquad& c : design.sections) {
+		w.put(c.b0);
+		w.put(c.b1);
+		w.put(c.b2);
+		w.put(c.a1);
+		w.put(c.a2);
+	}
+	if (!file.state.empty()) {
+		w.put<uint64_t>(file.state_channels);
+		w.putDoubles(file.state);
+	}
+	w.put<uint64_t>(fnv1a(w.bytes.data(), w.bytes.size()));
+	return std::move(w.bytes);
+}
+
+bool decodeBinary(const unsigned char* bytes, size_t size, CoefficientFile& file, std::string& error) {
+	if (size < sizeof(BINARY_MAGIC) + sizeof(uint64_t)) {
+		error = "file is truncated";
+		return false;
+	}
+	const size_t checked = size - sizeof(uint64_t);
+	uint64_t checksum;
+	std::memcpy(&checksum, bytes + checked, sizeof(checksum));
+	if (checksum != fnv1a(bytes, checked)) {
+		error = "checksum mismatch, the file is corrupt or truncated";
+		return false;
+	}
+
+	Reader r(bytes + sizeof(BINARY_MAGIC), bytes + checked);
+	const auto version = r.get<uint32_t>();
+	if (version == 0 || version > COEFFICIENT_FILE_VERSION) {
+		error = "unsupported format version " + std::to_string(version);
+		return false;
+	}
+	const auto flags = r.get<uint32_t>();
+	for (const SpecField& field : SPEC_FIELDS) {
+		if (field.since > version) { continue; }
+		switch (field.kind) {
+			case REAL: setReal(file.spec, field, r.get<double>()); break;
+			case FLAG: setInteger(file.spec, field, r.get<uint8_t>()); break;
+			default: setInteger(file.spec, field, r.get<int64_t>()); break;
+		}
+	}
+	auto design = std::make_shared<FilterDesign>();
+	r.getDoubles(design->numer_coeff);
+	r.getDoubles(design->denom_coeff);
+	const auto num_sections = r.get<uint64_t>();
+	if (r.ok && num_sections <= checked / sizeof(Biquad)) {
+		design->sections.resize(num_sections);
+		for (Biquad& c : design->sections) {
+			c.b0 = r.get<double>();
+			c.b1 = r.get<double>();
+			c.b2 = r.get<double>();
+			c.a1 = r.get<double>();
+			c.a2 = r.get<double>();
+		}
+	} else {
+		r.ok = false;
+	}
+	if ((flags & FLAG_STATE) != 0) {
+		file.state_channels = r.get<uint64_t>();
+		r.getDoubles(file.state);
+	}
+	if (!r.ok) {
+		error = "file is truncated";
+		return false;
+	}
+	file.design = std::move(design);
+	return true;
+}
+
+/*
+* SOS text format
+*/
+
+void appendDoubles(std::string& text, const double* values, size_t count) {
+	char number[32];
+	for (size_t i = 0; i < count; i++) {
+		std::snprintf(number, sizeof(number), " %.17g", values[i]);
+		text += number;
+	}
+}
+
+std::string encodeText(const CoefficientFile& file) {
+	std::string text = TEXT_MAGIC + std::to_string(COEFFICIENT_FILE_VERSION) + "\n";
+	char number[32];
+	for (const SpecField& field : SPEC_FIELDS) {
+		if (field.kind == REAL) {
+			std::snprintf(number, sizeof(number), "%.17g", getReal(file.spec, field));
+		} else {
+			std::snprintf(number, sizeof(number), "%lld", static_cast<long long>(getInteger(file.spec, field)));
+		}
+		text += std::string("spec ") + field.name + " " + number + "\n";
+	}
+	const FilterDesign& design = *file.design;
+	text += "numer";
+	appendDoubles(text, design.numer_coeff.data(), design.numer_coeff.size());
+	text += "\ndenom";
+	appendDoubles(text, design.denom_coeff.data(), design.denom_coeff.size());
+	text += "\n# section b0 b1 b2 a1 a2\n";
+	for (const Biquad& c : design.sections) {
+		const double coefficients[] = {c.b0, c.b1, c.b2, c.a1, c.a2};
+		text += "section";
+		appendDoubles(text, coefficients, 5);
+		text += "\n";
+	}
+	if (!file.state.empty()) {
+		// one line per section: z1 for every channel, then z2
+		text += "state_channels " + std::to_string(file.state_channels) + "\n";
+		const size_t per_section = 2 * file.state_channels;
+		for (size_t s = 0; s < design.sections.size(); s++) {
+			text += "state";
+			appendDoubles(text, file.state.data() + s * per_section, per_section);
+			text += "\n";
+		}
+	}
+	return text;
+}
+
+// the numbers after the keyword; false on anything that is not a number
+bool parseDoubles(const char* at, std::vector<double>& values) {
+	while (true) {
+		while (*at == ' ' || *at == '\t' || *at == '\r') { at++; }
+		if (*at == '\0') { return true; }
+		char* next;
+		values.push_back(std::strtod(at, &next));
+		if (next == at) { return false; }
+		at = next;
+	}
+}
+
+bool decodeText(const unsigned char* bytes, size_t size, CoefficientFile& file, std::string& error) {
+	const std::string text(bytes, bytes + size);
+	const long version = std::strtol(text.c_str() + std::strlen(TEXT_MAGIC), nullptr, 10);
+	if (version <= 0 || version > static_cast<long>(COEFFICIENT_FILE_VERSION)) {
+		error = "unsupported format version " + std::to_string(version);
+		return false;
+	}
+
+	auto design = std::make_shared<FilterDesign>();
+	bool seen[NUM_SPEC_FIELDS] = {};
+	size_t line_number = 1;
+	size_t begin = text.find('\n');
+	while (begin != std::string::npos && begin + 1 < text.size()) {
+		line_number++;
+		size_t end = text.find('\n', begin + 1);
+		const std::string line = text.substr(begin + 1, end == std::string::npos ? std::string::npos : end - begin - 1);
+		begin = end;
+		if (line.empty() || line[0] == '#') { continue; }
+
+		const size_t space = line.find(' ');
+		const std::string key = line.substr(0, space);
+		const char* rest = space == std::string::npos ? "" : line.c_str() + space + 1;
+		bool ok = true;
+		if (key == "spec") {
+			const std::string name(rest, std::strcspn(rest, " "));
+			const char* value = rest + name.size();
+			ok = false;
+			for (size_t i = 0; i < NUM_SPEC_FIELDS; i++) {
+				if (name != SPEC_FIELDS[i].name) { continue; }
+				char* next;
+				if (SPEC_FIELDS[i].kind == REAL) {
+					setReal(file.spec, SPEC_FIELDS[i], std::strtod(value, &next));
+				} else {
+					setInteger(file.spec, SPEC_FIELDS[i], std::strtoll(value, &next, 10));
+				}
+				ok = next != value;
+				seen[i] = true;
+			}
+		} else if (key == "numer") {
+			ok = parseDoubles(rest, design->numer_coeff);
+		} else if (key == "denom") {
+			ok = parseDoubles(rest, design->denom_coeff);
+		} else if (key == "section") {
+			std::vector<double> c;
+			ok = parseDoubles(rest, c) && c.size() == 5;
+			if (ok) { design->sections.push_back({c[0], c[1], c[2], c[3], c[4]}); }
+		} else if (key == "state_channels") {
+			file.state_channels = std::strtoul(rest, nullptr, 10);
+		} else if (key == "state") {
+			ok = parseDoubles(rest, file.state);
+		} else {
+			ok = false;
+		}
+		if (!ok) {
+			error = "line " + std::to_string(line_number) + ": cannot read \"" + line + "\"";
+			return false;
+		}
+	}
+	for (size_t i = 0; i < NUM_SPEC_FIELDS; i++) {
+		if (!seen[i] && SPEC_FIELDS[i].since <= static_cast<uint32_t>(version)) {
+			error = std::string("spec ") + SPEC_FIELDS[i].name + " is missing";
+			return false;
+		}
+	}
+	file.design = std::move(design);
+	return true;
+}
+
+} // namespace
+
+uint64_t specDigest(const FilterSpec& spec) {
+	Writer w;
+	putSpec(w, spec);
+	return fnv1a(w.bytes.data(), w.bytes.size());
+}
+
+std::vector<unsigned char> encodeCoefficients(const CoefficientFile& file) {
+	return encodeBinary(file);
+}
+
+bool decodeCoefficients(const unsigned char* bytes, size_t size, CoefficientFile& file, std::string& error) {
+	CoefficientFile result;
+	bool decoded;
+	if (size >= sizeof(BINARY_MAGIC) && std::memcmp(bytes, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0) {
+		decoded = decodeBinary(bytes, size, result, error);
+	} else if (size >= std::strlen(TEXT_MAGIC) && std::memcmp(bytes, TEXT_MAGIC, std::strlen(TEXT_MAGIC)) == 0) {
+		decoded = decodeText(bytes, size, result, error);
+	} else {
+		error = "not a coefficient file";
+		return false;
+	}
+	if (!decoded || !validate(result, error)) { return false; }
+	file = std::move(result);
+	return true;
+}
+
+bool saveCoefficients(const std::string& path, const CoefficientFile& file,
+	coefficient_format_t format, std::string& error) {
+	if (file.design == nullptr) {
+		error = "no design to save";
+		return false;
+	}
+	if (file.state.size() != stateSize(file)) {
+		error = "state does not match the sections";
+		return false;
+	}
+	if (format == COEFFICIENTS_SOS_TEXT) {
+		const std::string text = encodeText(file);
+		return writeFile(path, text.data(), text.size(), error);
+	}
+	const std::vector<unsigned char> bytes = encodeBinary(file);
+	return writeFile(path, bytes.data(), bytes.size(), error);
+}
+
+bool loadCoefficients(const std::string& path, CoefficientFile& file, std::string& error) {
+	std::vector<unsigned char> bytes;
+	if (!readFile(path, bytes, error)) { return false; }
+	if (!decodeCoefficients(bytes.data(), bytes.size(), file, error)) {
+		error = path + ": " + error;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,75 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* saveCoefficients, loadCoefficients
+* A finished filter on disk: the spec it was built from, its design (direct
+* form and second-order sections) and optionally the running state of its
+* sections, so that a filter can be put back exactly as it was without
+* running the design pipeline.
+*
+* Two formats, told apart on load by their first bytes:
+*   binary: "IIRCOEF" magic, format version, the spec field by field, the
+*     coefficients as native doubles, then an FNV-1a checksum of everything
+*     before it. Compact and exact.
+*   SOS text: a "# iir-filter sos <version>" line, then "spec <field>
+*     <value>", "numer", "denom", "section b0 b1 b2 a1 a2" and "state"
+*     lines, with every double written to 17 significant digits so that it
+*     reads back to the same bits. For reading and for other tools.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "filter-design.hpp"
+
+constexpr uint32_t COEFFICIENT_FILE_VERSION = 2;
+
+struct CoefficientFile {
+	FilterSpec spec{}; // as built: a concrete type and order, canonical
+	std::shared_ptr<const FilterDesign> design;
+	// the sections' state (SosBank::getState() layout), empty if not saved
+	size_t state_channels = 0;
+	std::vector<double> state;
+};
+
+enum coefficient_format_t {
+	COEFFICIENTS_BINARY=0,
+	COEFFICIENTS_SOS_TEXT,
+};
+
+// Write the whole file in one go. On failure returns false with a reason in
+// error.
+bool saveCoefficients(const std::string& path, const CoefficientFile& file,
+	coefficient_format_t format, std::string& error);
+
+// Read either format. The file is checked (checksum, counts, a state that
+// matches the sections) before anything is returned.
+bool loadCoefficients(const std::string& path, CoefficientFile& file, std::string& error);
+
+// The same in memory: the binary format, and either format back (for a
+// mapped file, say).
+std::vector<unsigned char> encodeCoefficients(const CoefficientFile& file);
+bool decodeCoefficients(const unsigned char* bytes, size_t size, CoefficientFile& file, std::string& error);
+
+// FNV-1a over the spec as the binary format stores it: the same in every
+// process and build, unlike FilterSpecHash.
+uint64_t specDigest(const FilterSpec& spec);
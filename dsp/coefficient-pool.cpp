@@ -0,0 +1,121 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include "coefficient-pool.hpp"
+#include "filter-design.hpp"
+
+namespace {
+
+uint64_t fnv1a(const void* data, size_t bytes) {
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < bytes; i++) {
+		hash = (hash ^ p[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+} // namespace
+
+struct CoefficientPool::Designs {
+	std::unordered_map<FilterSpec, std::weak_ptr<const FilterDesign>, FilterSpecHash> entries;
+};
+
+CoefficientPool::CoefficientPool() : designs(std::make_unique<Designs>()) {}
+CoefficientPool::~CoefficientPool() = default;
+
+CoefficientPool& CoefficientPool::instance() {
+	// leaked, so that blocks released during static destruction still find it
+	static CoefficientPool* pool = new CoefficientPool;
+	return *pool;
+}
+
+std::shared_ptr<const void> CoefficientPool::internBytes(const void* values, size_t bytes) {
+	const uint64_t digest = fnv1a(values, bytes);
+	// blocks looked at but not taken; let go of after the lock, since the
+	// last reference to one runs release()
+	std::vector<std::shared_ptr<const void>> looked_at;
+	std::lock_guard<std::mutex> lock(mutex);
+	const auto range = blocks.equal_range(digest);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second.bytes != bytes) { continue; }
+		// an expired block is about to be erased by its deleter
+		std::shared_ptr<const void> block = it->second.block.lock();
+		if (block != nullptr && std::memcmp(block.get(), values, bytes) == 0) { return block; }
+		looked_at.push_back(std::move(block));
+	}
+
+	const size_t allocated = (bytes + COEFFICIENT_ALIGNMENT - 1) / COEFFICIENT_ALIGNMENT * COEFFICIENT_ALIGNMENT;
+	void* data = std::aligned_alloc(COEFFICIENT_ALIGNMENT, allocated);
+	if (data == nullptr) { throw std::bad_alloc(); }
+	std::memcpy(data, values, bytes);
+	std::shared_ptr<const void> block(data, [this, digest](const void* p) {
+		release(digest, p);
+		std::free(const_cast<void*>(p));
+	});
+	blocks.emplace(digest, Block{data, bytes, block});
+	live_bytes += bytes;
+	return block;
+}
+
+void CoefficientPool::release(uint64_t digest, const void* data) {
+	std::lock_guard<std::mutex> lock(mutex);
+	const auto range = blocks.equal_range(digest);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second.data == data) {
+			live_bytes -= it->second.bytes;
+			blocks.erase(it);
+			return;
+		}
+	}
+}
+
+std::shared_ptr<const FilterDesign> CoefficientPool::intern(const FilterSpec& spec,
+	std::shared_ptr<const FilterDesign> design)
+{
+	const FilterSpec key = designKey(spec);
+	std::lock_guard<std::mutex> lock(mutex);
+	std::weak_ptr<const FilterDesign>& entry = designs->entries[key];
+	if (std::shared_ptr<const FilterDesign> live = entry.lock()) { return live; }
+	entry = design;
+	// drop the entries of designs nobody holds any more
+	for (auto it = designs->entries.begin(); it != designs->entries.end(); ) {
+		it = it->second.expired() ? designs->entries.erase(it) : std::next(it);
+	}
+	return design;
+}
+
+std::shared_ptr<const FilterDesign> CoefficientPool::find(const FilterSpec& spec) {
+	std::lock_guard<std::mutex> lock(mutex);
+	const auto found = designs->entries.find(designKey(spec));
+	return found == designs->entries.end() ? nullptr : found->second.lock();
+}
+
+size_t CoefficientPool::numBlocks() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return blocks.size();
+}
+
+size_t CoefficientPool::numBytes() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return live_bytes;
+}
@@ -0,0 +1,118 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* CoefficientPool
+* One process-wide home for read-only coefficients, so that many filters
+* with the same settings (dozens of plugin instances in one tick, say) run
+* from one copy instead of one each. Two things are interned:
+*   designs, by designKey(spec): every instance asking for the same design
+*     gets the same FilterDesign, whichever instance designed it first;
+*   coefficient blocks, by content: the arrays the banks (SosBank,
+*     FixedSosBank, the topologies) run from, copied once into a block
+*     aligned to a cache line. Only the state is private to a bank.
+* Both are reference counted and held weakly by the pool, so whatever the
+* last filter using them lets go of is freed. The pool is thread safe; it is
+* only consulted when a filter is built, never while one runs.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// filter-design.hpp needs the banks, which need this
+struct FilterSpec;
+struct FilterDesign;
+
+constexpr size_t COEFFICIENT_ALIGNMENT = 64; // one cache line
+
+// A read-only array shared through the pool, used like the vector it
+// replaces. Empty (and without a block) when there are no values.
+template<typename T>
+class SharedCoefficients {
+	public:
+		SharedCoefficients() = default;
+		SharedCoefficients(std::shared_ptr<const T> block, size_t count)
+			: block(std::move(block)), count(count) {}
+
+		const T* data() const { return block.get(); }
+		size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+		const T& operator[](size_t i) const { return block.get()[i]; }
+		const T* begin() const { return data(); }
+		const T* end() const { return data() + count; }
+
+	private:
+		std::shared_ptr<const T> block;
+		size_t count = 0;
+};
+
+class CoefficientPool {
+	public:
+		// the one pool of the process, never destroyed
+		static CoefficientPool& instance();
+
+		// The shared block holding exactly these values, made from them if no
+		// live block does. Blocks are matched on their bytes, so values that
+		// differ in any bit (0 and -0, say) are kept apart.
+		template<typename T>
+		SharedCoefficients<T> intern(const std::vector<T>& values) {
+			static_assert(std::is_trivially_copyable_v<T>, "coefficients are shared as bytes");
+			static_assert(alignof(T) <= COEFFICIENT_ALIGNMENT, "blocks are aligned to a cache line");
+			if (values.empty()) { return {}; }
+			std::shared_ptr<const void> block = internBytes(values.data(), values.size() * sizeof(T));
+			return {std::static_pointer_cast<const T>(block), values.size()};
+		}
+
+		// The live design for spec's designKey if there is one, otherwise
+		// design, which becomes the one every later caller gets.
+		std::shared_ptr<const FilterDesign> intern(const FilterSpec& spec,
+			std::shared_ptr<const FilterDesign> design);
+		// the live design for spec's designKey, or nullptr
+		std::shared_ptr<const FilterDesign> find(const FilterSpec& spec);
+
+		// live blocks and the bytes they hold, for logging
+		size_t numBlocks() const;
+		size_t numBytes() const;
+
+	private:
+		CoefficientPool();
+		~CoefficientPool();
+
+		std::shared_ptr<const void> internBytes(const void* values, size_t bytes);
+		void release(uint64_t digest, const void* data);
+
+		struct Block {
+			const void* data; // identifies the entry once the block has expired
+			size_t bytes;
+			std::weak_ptr<const void> block;
+		};
+
+		struct Designs; // by designKey
+
+		mutable std::mutex mutex;
+		std::unordered_multimap<uint64_t, Block> blocks; // by FNV-1a of the bytes
+		std::unique_ptr<Designs> designs;
+		size_t live_bytes = 0;
+};
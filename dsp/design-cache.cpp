@@ -0,0 +1,63 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "coefficient-pool.hpp"
+#include "design-cache.hpp"
+
+std::shared_ptr<const FilterDesign> DesignCache::get(const FilterSpec& spec) {
+	const FilterSpec key = designKey(spec);
+	auto found = index.find(key);
+	if (found != index.end()) {
+		hits++;
+		entries.splice(entries.begin(), entries, found->second);
+		return found->second->second;
+	}
+
+	misses++;
+	CoefficientPool& pool = CoefficientPool::instance();
+	std::shared_ptr<const FilterDesign> design = pool.find(key);
+	if (design == nullptr && design_store != nullptr) { design = design_store->find(key); }
+	if (design == nullptr) {
+		design = designFilter(spec);
+		if (design_store != nullptr) { design_store->store(key, design); }
+	}
+	// another thread may have made the same design meanwhile
+	design = pool.intern(key, std::move(design));
+	store(key, design);
+	return design;
+}
+
+void DesignCache::insert(const FilterSpec& spec, std::shared_ptr<const FilterDesign> design) {
+	const FilterSpec key = designKey(spec);
+	auto found = index.find(key);
+	if (found != index.end()) {
+		entries.erase(found->second);
+		index.erase(found);
+	}
+	store(key, std::move(design));
+}
+
+void DesignCache::store(const FilterSpec& key, std::shared_ptr<const FilterDesign> design) {
+	if (capacity == 0) { return; }
+	if (entries.size() >= capacity) {
+		index.erase(entries.back().first);
+		entries.pop_back();
+	}
+	entries.emplace_front(key, std::move(design));
+	index[key] = entries.begin();
+}
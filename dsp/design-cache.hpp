@@ -0,0 +1,65 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* DesignCache
+* Least-recently-used cache of finished designs keyed on designKey(spec), so
+* flipping back and forth between settings reuses earlier designs instead of
+* running the analog prototype and bilinear transform again. Given a
+* DesignStore, a miss looks there before designing and every new design is
+* stored, so designs also outlive the session. Before either, a miss takes
+* the design from the CoefficientPool if another cache in the process holds
+* it, so instances with the same settings share one FilterDesign. Not
+* thread safe; meant to be owned by a single design thread.
+*/
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include "design-store.hpp"
+#include "filter-design.hpp"
+
+class DesignCache {
+	public:
+		explicit DesignCache(size_t capacity = 16, DesignStore* store = nullptr)
+			: capacity(capacity), design_store(store) {}
+
+		// the design for spec, running the design pipeline only on a miss
+		std::shared_ptr<const FilterDesign> get(const FilterSpec& spec);
+		// store a design made elsewhere (e.g. loaded with loadCoefficients())
+		// as the design for spec, so that the next get() for it is a hit
+		void insert(const FilterSpec& spec, std::shared_ptr<const FilterDesign> design);
+
+		size_t getHits() const { return hits; }
+		size_t getMisses() const { return misses; }
+
+	private:
+		void store(const FilterSpec& key, std::shared_ptr<const FilterDesign> design);
+
+		using Entry = std::pair<FilterSpec, std::shared_ptr<const FilterDesign>>;
+
+		size_t capacity;
+		DesignStore* design_store; // not owned, may be null
+		std::list<Entry> entries; // most recently used first
+		std::unordered_map<FilterSpec, std::list<Entry>::iterator, FilterSpecHash> index;
+		size_t hits = 0;
+		size_t misses = 0;
+};
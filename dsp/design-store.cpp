@@ -0,0 +1,132 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "coefficient-file.hpp"
+#include "design-store.hpp"
+
+namespace {
+
+// every missing directory along path, like mkdir -p
+bool makeDirectories(const std::string& path) {
+	for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+		const std::string prefix = path.substr(0, slash);
+		if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) { return false; }
+		if (slash == std::string::npos) { return true; }
+	}
+}
+
+bool writeAll(int fd, const unsigned char* data, size_t size) {
+	while (size > 0) {
+		const ssize_t written = write(fd, data, size);
+		if (written < 0) {
+			if (errno == EINTR) { continue; }
+			return false;
+		}
+		data += written;
+		size -= static_cast<size_t>(written);
+	}
+	return true;
+}
+
+} // namespace
+
+DesignStore::DesignStore(std::string directory) : directory(std::move(directory)) {}
+
+std::string DesignStore::defaultDirectory() {
+	if (const char* configured = std::getenv("IIR_FILTER_DESIGN_STORE")) {
+		const std::string value = configured;
+		return value == "off" ? std::string() : value;
+	}
+	if (const char* cache = std::getenv("XDG_CACHE_HOME"); cache != nullptr && cache[0] == '/') {
+		return std::string(cache) + "/rtxi-iir-filter";
+	}
+	if (const char* home = std::getenv("HOME"); home != nullptr && home[0] == '/') {
+		return std::string(home) + "/.cache/rtxi-iir-filter";
+	}
+	return {};
+}
+
+std::string DesignStore::path(const FilterSpec& key) const {
+	char name[64];
+	std::snprintf(name, sizeof(name), "/%016llx.v%u.iir",
+		static_cast<unsigned long long>(specDigest(key)), DESIGN_STORE_VERSION);
+	return directory + name;
+}
+
+std::shared_ptr<const FilterDesign> DesignStore::find(const FilterSpec& spec) {
+	if (!enabled()) { return nullptr; }
+	const FilterSpec key = designKey(spec);
+	const int fd = open(path(key).c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		misses++;
+		return nullptr;
+	}
+	struct stat info;
+	void* mapped = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && info.st_size > 0) {
+		mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (mapped == MAP_FAILED) {
+		misses++;
+		return nullptr;
+	}
+
+	CoefficientFile file;
+	std::string error;
+	const bool decoded = decodeCoefficients(static_cast<const unsigned char*>(mapped),
+		static_cast<size_t>(info.st_size), file, error);
+	munmap(mapped, static_cast<size_t>(info.st_size));
+	// a corrupt file, or another key with the same digest
+	if (!decoded || file.spec != key) {
+		misses++;
+		return nullptr;
+	}
+	hits++;
+	return file.design;
+}
+
+void DesignStore::store(const FilterSpec& spec, std::shared_ptr<const FilterDesign> design) {
+	if (!enabled()) { return; }
+	if (!created) {
+		if (!makeDirectories(directory)) { return; }
+		created = true;
+	}
+	CoefficientFile file;
+	file.spec = designKey(spec);
+	file.design = std::move(design);
+	const std::vector<unsigned char> bytes = encodeCoefficients(file);
+
+	const std::string final_path = path(file.spec);
+	std::string temporary = final_path + ".XXXXXX";
+	const int fd = mkstemp(temporary.data());
+	if (fd < 0) { return; }
+	const bool written = writeAll(fd, bytes.data(), bytes.size());
+	const bool closed = close(fd) == 0;
+	if (!written || !closed || rename(temporary.c_str(), final_path.c_str()) != 0) {
+		unlink(temporary.c_str());
+	}
+}
@@ -0,0 +1,72 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* DesignStore
+* Finished designs kept on disk, so a filter designed once is never designed
+* again by any session or process of the same user. Each design is its own
+* small file in the binary coefficient format (coefficient-file.hpp), named
+* after specDigest(designKey(spec)) and DESIGN_STORE_VERSION; a lookup maps
+* the file and decodes it, which costs a page-in rather than a design. The
+* stored spec is compared in full, so a digest collision is only a miss.
+*
+* Files are written to a temporary name and renamed into place, so readers
+* in other processes see a whole file or none, and concurrent writers of the
+* same design simply replace each other's identical file. Every failure is a
+* miss: the store is only ever a shortcut.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "filter-design.hpp"
+
+// bump whenever the design pipeline changes what it produces, so that
+// designs stored by an older build are not used
+constexpr uint32_t DESIGN_STORE_VERSION = 1;
+
+class DesignStore {
+	public:
+		// an empty directory turns the store off
+		explicit DesignStore(std::string directory);
+
+		// $IIR_FILTER_DESIGN_STORE if set ("" or "off" for none), otherwise
+		// $XDG_CACHE_HOME/rtxi-iir-filter or ~/.cache/rtxi-iir-filter
+		static std::string defaultDirectory();
+
+		// the stored design for spec, or nullptr
+		std::shared_ptr<const FilterDesign> find(const FilterSpec& spec);
+		// keep design as the design for spec
+		void store(const FilterSpec& spec, std::shared_ptr<const FilterDesign> design);
+
+		bool enabled() const { return !directory.empty(); }
+		const std::string& getDirectory() const { return directory; }
+		size_t getHits() const { return hits.load(std::memory_order_relaxed); }
+		size_t getMisses() const { return misses.load(std::memory_order_relaxed); }
+
+	private:
+		std::string path(const FilterSpec& key) const;
+
+		std::string directory;
+		bool created = false; // directory made (or found) by this store
+		std::atomic<size_t> hits{0};
+		std::atomic<size_t> misses{0};
+};
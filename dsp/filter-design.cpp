@@ -0,0 +1,482 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <functional>
+#include "filter-design.hpp"
+#include "numeric-health.hpp"
+
+namespace {
+
+using cplx = std::complex<double>;
+
+constexpr double PI = 3.14159265358979323846;
+
+// poles and zeros closer than this (relative) to the real axis are real
+constexpr double REAL_TOLERANCE = 1e-9;
+
+bool isReal(cplx value) {
+	return std::abs(value.imag()) <= REAL_TOLERANCE * std::max(1.0, std::abs(value));
+}
+
+cplx bilinear(cplx s, double dt) {
+	const double k = 2.0 / dt;
+	return (k + s) / (k - s);
+}
+
+// Splits digital roots into one representative per complex-conjugate pair
+// (upper half plane) and a list of real roots.
+template<typename Roots>
+void splitRoots(const Roots& roots, std::vector<cplx>& pairs, std::vector<double>& reals) {
+	for (cplx root : roots) {
+		if (isReal(root)) {
+			reals.push_back(root.real());
+		} else if (root.imag() > 0) {
+			pairs.push_back(root);
+		}
+	}
+}
+
+// Pull the numerator for a section out of the remaining zeros, preferring the
+// complex pair nearest to the section's pole.
+void takeZeros(cplx pole, int count, std::vector<cplx>& zero_pairs,
+	std::vector<double>& real_zeros, Biquad& section) {
+	section.b0 = 1; section.b1 = 0; section.b2 = 0;
+	if (count == 2 && !zero_pairs.empty()) {
+		auto nearest = std::min_element(zero_pairs.begin(), zero_pairs.end(),
+			[pole](cplx a, cplx b) { return std::abs(a - pole) < std::abs(b - pole); });
+		section.b1 = -2 * nearest->real();
+		section.b2 = std::norm(*nearest);
+		zero_pairs.erase(nearest);
+		return;
+	}
+	if (count >= 1 && !real_zeros.empty()) {
+		double first = real_zeros.back();
+		real_zeros.pop_back();
+		section.b1 = -first;
+		if (count == 2 && !real_zeros.empty()) {
+			double second = real_zeros.back();
+			real_zeros.pop_back();
+			section.b1 = -(first + second);
+			section.b2 = first * second;
+		}
+	}
+}
+
+// multiply out the sections into one direct form, b over a with a[0] = 1
+void expandSections(const std::vector<Biquad>& sections, std::vector<double>& numer,
+	std::vector<double>& denom) {
+	numer.assign(1, 1.0);
+	denom.assign(1, 1.0);
+	auto multiply = [](std::vector<double>& poly, double c0, double c1, double c2) {
+		std::vector<double> result(poly.size() + 2, 0.0);
+		for (size_t i = 0; i < poly.size(); i++) {
+			result[i] += c0 * poly[i];
+			result[i + 1] += c1 * poly[i];
+			result[i + 2] += c2 * poly[i];
+		}
+		poly = std::move(result);
+	};
+	for (const Biquad& c : sections) {
+		multiply(numer, c.b0, c.b1, c.b2);
+		multiply(denom, 1, c.a1, c.a2);
+	}
+}
+
+// scale a section's numerator for unity gain at DC
+void normalizeDc(Biquad& section) {
+	const double numer = section.b0 + section.b1 + section.b2;
+	const double denom = 1 + section.a1 + section.a2;
+	if (numer == 0) { return; }
+	const double scale = denom / numer;
+	section.b0 *= scale;
+	section.b1 *= scale;
+	section.b2 *= scale;
+}
+
+} // namespace
+
+std::vector<Biquad> makeSections(FilterTransFunc* analog_filter, const FilterSpec& spec) {
+	int num_poles = 0;
+	int num_zeros = 0;
+	// prototype arrays are 1-based, as everywhere else in the DSP library
+	std::complex<double>* analog_poles = analog_filter->GetPrototypePoles(&num_poles);
+	std::complex<double>* analog_zeros = analog_filter->GetPrototypeZeros(&num_zeros);
+
+	std::vector<cplx> poles;
+	std::vector<cplx> zeros;
+	for (int i = 1; i <= num_poles; i++) {
+		poles.push_back(bilinear(analog_poles[i], spec.dt));
+	}
+	for (int i = 1; i <= num_zeros; i++) {
+		zeros.push_back(bilinear(analog_zeros[i], spec.dt));
+	}
+	// zeros at infinity in s land on Nyquist
+	for (int i = num_zeros; i < num_poles; i++) {
+		zeros.emplace_back(-1.0, 0.0);
+	}
+
+	std::vector<cplx> pole_pairs;
+	std::vector<double> real_poles;
+	std::vector<cplx> zero_pairs;
+	std::vector<double> real_zeros;
+	splitRoots(poles, pole_pairs, real_poles);
+	splitRoots(zeros, zero_pairs, real_zeros);
+
+	// the most resonant poles claim their nearest zeros first
+	std::sort(pole_pairs.begin(), pole_pairs.end(),
+		[](cplx a, cplx b) { return std::abs(a) > std::abs(b); });
+	std::sort(real_poles.begin(), real_poles.end(),
+		[](double a, double b) { return std::abs(a) > std::abs(b); });
+
+	std::vector<Biquad> sections;
+	for (cplx pole : pole_pairs) {
+		Biquad section{};
+		section.a1 = -2 * pole.real();
+		section.a2 = std::norm(pole);
+		takeZeros(pole, 2, zero_pairs, real_zeros, section);
+		sections.push_back(section);
+	}
+	for (size_t i = 0; i < real_poles.size(); i += 2) {
+		Biquad section{};
+		if (i + 1 < real_poles.size()) {
+			section.a1 = -(real_poles[i] + real_poles[i + 1]);
+			section.a2 = real_poles[i] * real_poles[i + 1];
+			takeZeros(real_poles[i], 2, zero_pairs, real_zeros, section);
+		} else {
+			section.a1 = -real_poles[i];
+			takeZeros(real_poles[i], 1, zero_pairs, real_zeros, section);
+		}
+		sections.push_back(section);
+	}
+
+	// run the least resonant sections first to keep intermediate peaks down
+	std::reverse(sections.begin(), sections.end());
+	for (Biquad& section : sections) { normalizeDc(section); }
+
+	// even order Chebyshev and elliptical filters sit at the bottom of the
+	// passband ripple at DC
+	const bool ripples = spec.filter_type == CHEBY || spec.filter_type == ELLIP;
+	if (!sections.empty() && ripples && spec.filter_order % 2 == 0) {
+		const double dc_gain = std::pow(10.0, -spec.passband_ripple / 20.0);
+		sections.front().b0 *= dc_gain;
+		sections.front().b1 *= dc_gain;
+		sections.front().b2 *= dc_gain;
+	}
+	return sections;
+}
+
+std::vector<Biquad> makeNotchSections(const FilterSpec& spec) {
+	std::vector<Biquad> sections;
+	const double nyquist = 0.5 / spec.dt;
+	for (int k = 1; k <= spec.notch_harmonics; k++) {
+		const double freq = k * spec.notch_frequency;
+		if (freq <= 0 || freq >= nyquist) { break; }
+		const double w0 = 2 * PI * freq * spec.dt;
+		const double alpha = std::sin(w0) / (2 * spec.notch_q);
+		const double a0 = 1 + alpha;
+		const double cos_w0 = std::cos(w0);
+		sections.push_back({1 / a0, -2 * cos_w0 / a0, 1 / a0, -2 * cos_w0 / a0, (1 - alpha) / a0});
+	}
+	return sections;
+}
+
+bool FilterSpec::operator==(const FilterSpec& other) const {
+	return filter_type == other.filter_type
+		&& filter_order == other.filter_order
+		&& passband_ripple == other.passband_ripple
+		&& stopband_ripple == other.stopband_ripple
+		&& passband_edge == other.passband_edge
+		&& stopband_edge == other.stopband_edge
+		&& ripple_bw_norm == other.ripple_bw_norm
+		&& quant_enabled == other.quant_enabled
+		&& predistort_enabled == other.predistort_enabled
+		&& input_quan_factor == other.input_quan_factor
+		&& coeff_quan_factor == other.coeff_quan_factor
+		&& implementation == other.implementation
+		&& full_scale == other.full_scale
+		&& notch_frequency == other.notch_frequency
+		&& notch_harmonics == other.notch_harmonics
+		&& notch_q == other.notch_q
+		&& dt == other.dt
+		&& auto_order == other.auto_order
+		&& multirate == other.multirate
+		&& decimation == other.decimation
+		&& interpolate == other.interpolate
+		&& precision == other.precision;
+}
+
+size_t FilterSpecHash::operator()(const FilterSpec& spec) const {
+	size_t seed = 0;
+	auto combine = [&seed](size_t value) {
+		seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+	};
+	combine(std::hash<uint64_t>()(spec.filter_type));
+	combine(std::hash<int>()(spec.filter_order));
+	combine(std::hash<double>()(spec.passband_ripple));
+	combine(std::hash<double>()(spec.stopband_ripple));
+	combine(std::hash<double>()(spec.passband_edge));
+	combine(std::hash<double>()(spec.stopband_edge));
+	combine(std::hash<int>()(spec.ripple_bw_norm));
+	combine(std::hash<bool>()(spec.quant_enabled));
+	combine(std::hash<bool>()(spec.predistort_enabled));
+	combine(std::hash<int>()(spec.input_quan_factor));
+	combine(std::hash<int>()(spec.coeff_quan_factor));
+	combine(std::hash<uint64_t>()(spec.implementation));
+	combine(std::hash<double>()(spec.full_scale));
+	combine(std::hash<double>()(spec.notch_frequency));
+	combine(std::hash<int>()(spec.notch_harmonics));
+	combine(std::hash<double>()(spec.notch_q));
+	combine(std::hash<double>()(spec.dt));
+	combine(std::hash<bool>()(spec.auto_order));
+	combine(std::hash<bool>()(spec.multirate));
+	combine(std::hash<int>()(spec.decimation));
+	combine(std::hash<bool>()(spec.interpolate));
+	combine(std::hash<uint64_t>()(spec.precision));
+	return seed;
+}
+
+FilterSpec canonicalSpec(const FilterSpec& spec) {
+	FilterSpec result = spec;
+	if (spec.auto_order) {
+		// the search picks these, and reads every edge and ripple
+		result.filter_type = 0;
+		result.filter_order = 0;
+	} else {
+		switch (static_cast<filter_t>(spec.filter_type)) {
+			case BUTTER:
+				result.passband_ripple = 0;
+				result.stopband_ripple = 0;
+				result.stopband_edge = 0;
+				result.ripple_bw_norm = 0;
+				break;
+			case CHEBY:
+				result.stopband_ripple = 0;
+				result.stopband_edge = 0;
+				break;
+			case ELLIP:
+				result.ripple_bw_norm = 0;
+				break;
+			case NOTCH:
+				result.filter_order = 0;
+				result.passband_ripple = 0;
+				result.passband_edge = 0;
+				result.stopband_ripple = 0;
+				result.stopband_edge = 0;
+				result.ripple_bw_norm = 0;
+				result.predistort_enabled = false;
+				// notches only run as sections
+				result.quant_enabled = false;
+				if (result.implementation == DIRECT) { result.implementation = SECTIONS; }
+				break;
+		}
+	}
+	if (result.filter_type != NOTCH) {
+		result.notch_frequency = 0;
+		result.notch_harmonics = 0;
+		result.notch_q = 0;
+	}
+	if (result.quant_enabled) {
+		result.implementation = 0;
+		result.full_scale = 0;
+	} else {
+		result.input_quan_factor = 0;
+		result.coeff_quan_factor = 0;
+		if (spec.implementation != FIXED_Q15 && spec.implementation != FIXED_Q31) {
+			result.full_scale = 0;
+		}
+	}
+	if (result.quant_enabled || result.implementation != SECTIONS) {
+		result.precision = DOUBLE_PRECISION;
+	}
+	if (result.multirate) {
+		// an automatic factor and the same factor asked for are the same filter
+		result.decimation = static_cast<int>(decimationFactor(result));
+		result.multirate = result.decimation > 1;
+	}
+	if (!result.multirate) {
+		result.decimation = 0;
+		result.interpolate = false;
+	}
+	return result;
+}
+
+FilterSpec designKey(const FilterSpec& spec) {
+	FilterSpec result = canonicalSpec(spec);
+	result.quant_enabled = false;
+	result.input_quan_factor = 0;
+	result.coeff_quan_factor = 0;
+	result.implementation = 0;
+	result.full_scale = 0;
+	result.precision = 0;
+	// designs at the same decimated rate are the same design
+	return decimatedSpec(result);
+}
+
+size_t decimationFactor(const FilterSpec& spec) {
+	if (!spec.multirate || !(spec.dt > 0)) { return 1; }
+	if (spec.decimation > 0) { return std::min<size_t>(spec.decimation, MAX_DECIMATION); }
+	double highest = spec.passband_edge;
+	if (spec.filter_type == NOTCH) {
+		highest = spec.notch_frequency * spec.notch_harmonics;
+	} else if (spec.auto_order || spec.filter_type == ELLIP) {
+		highest = std::max(spec.passband_edge, spec.stopband_edge);
+	}
+	if (!(highest > 0)) { return 1; }
+	const double factor = std::floor(1 / (spec.dt * DECIMATION_MARGIN * highest));
+	return static_cast<size_t>(std::clamp(factor, 1.0, static_cast<double>(MAX_DECIMATION)));
+}
+
+FilterSpec decimatedSpec(const FilterSpec& spec) {
+	FilterSpec result = spec;
+	result.dt = spec.dt * static_cast<double>(decimationFactor(spec));
+	result.multirate = false;
+	result.decimation = 0;
+	result.interpolate = false;
+	return result;
+}
+
+void FilterBlock::setSteadyState(const double* in) {
+	if (fixed_sections.numChannels() > 0 || !filter_implems.empty()) { return; }
+	if (topology != nullptr) {
+		topology->setSteadyState(in);
+	} else {
+		sections.setSteadyState(in);
+	}
+	if (resampler != nullptr) {
+		// what the sections settle to, the same at any rate
+		double gain = 1;
+		for (const Biquad& c : design->sections) {
+			const double denom = 1 + c.a1 + c.a2;
+			gain *= denom == 0 ? 0 : (c.b0 + c.b1 + c.b2) / denom;
+		}
+		resampler->setSteadyState(in, gain);
+	}
+}
+
+bool FilterBlock::recover(const double* in) {
+	if (!filter_implems.empty()) { return false; }
+	sections.reset();
+	fixed_sections.reset();
+	if (topology != nullptr) { topology->reset(); }
+	if (resampler != nullptr) { resampler->reset(); }
+	if (isHealthy(in, numChannels())) { setSteadyState(in); }
+	return true;
+}
+
+std::shared_ptr<const FilterDesign> designFilter(const FilterSpec& spec) {
+	if (spec.multirate) { return designFilter(decimatedSpec(spec)); }
+	if (spec.filter_type == NOTCH) {
+		auto design = std::make_shared<FilterDesign>();
+		design->sections = makeNotchSections(spec);
+		expandSections(design->sections, design->numer_coeff, design->denom_coeff);
+		return design;
+	}
+
+	std::unique_ptr<FilterTransFunc> analog_filter;
+	switch (static_cast<filter_t>(spec.filter_type)) {
+		case BUTTER:
+			analog_filter = std::make_unique<ButterworthTransFunc>(spec.filter_order);
+			analog_filter->LowpassDenorm(spec.passband_edge);
+			break;
+
+		case CHEBY:
+			analog_filter = std::make_unique<ChebyshevTransFunc>(spec.filter_order,
+			spec.passband_ripple, spec.ripple_bw_norm);
+			analog_filter->LowpassDenorm(spec.passband_edge);
+			break;
+
+		case ELLIP:
+		default:
+			int upper_summation_limit = 5;
+			analog_filter = std::make_unique<EllipticalTransFunc>(spec.filter_order,
+			spec.passband_ripple, spec.stopband_ripple, spec.passband_edge,
+			spec.stopband_edge * TWO_PI, upper_summation_limit);
+			break;
+	} // end of switch on window_shape
+
+	if (spec.predistort_enabled) analog_filter->FrequencyPrewarp(spec.dt);
+
+	std::unique_ptr<IirFilterDesign> filter_design(BilinearTransf(analog_filter.get(), spec.dt));
+	auto design = std::make_shared<FilterDesign>();
+	// the library hands out coefficient copies that the caller must free
+	double* numer_coeff = filter_design->GetNumerCoefficients();
+	double* denom_coeff = filter_design->GetDenomCoefficients();
+	design->numer_coeff.assign(numer_coeff, numer_coeff + filter_design->GetNumNumerCoeffs());
+	design->denom_coeff.assign(denom_coeff, denom_coeff + filter_design->GetNumDenomCoeffs() + 1);
+	delete[] numer_coeff;
+	delete[] denom_coeff;
+	design->sections = makeSections(analog_filter.get(), spec);
+	return design;
+}
+
+std::unique_ptr<FilterBlock> makeFilter(const FilterSpec& spec, size_t channels) {
+	return makeFilter(designFilter(spec), spec, channels);
+}
+
+std::unique_ptr<FilterBlock> makeFilter(std::shared_ptr<const FilterDesign> design,
+	const FilterSpec& spec, size_t channels) {
+	auto block = std::make_unique<FilterBlock>();
+	block->design = std::move(design);
+	// the library takes non-const arrays but only reads them
+	const int num_numer = static_cast<int>(block->design->numer_coeff.size());
+	const int num_denom = static_cast<int>(block->design->denom_coeff.size()) - 1;
+	double* numer_coeff = const_cast<double*>(block->design->numer_coeff.data());
+	double* denom_coeff = const_cast<double*>(block->design->denom_coeff.data());
+
+	// the DSP library's direct forms only take its own designs
+	const bool library_design = spec.filter_type != NOTCH;
+	if (spec.quant_enabled && library_design) {
+		for (size_t i = 0; i < channels; i++) {
+			block->filter_implems.push_back(std::make_unique<DirectFormIir>(num_numer,
+				num_denom, numer_coeff, denom_coeff, spec.coeff_quan_factor,
+				spec.input_quan_factor));
+		}
+	} else if (spec.implementation == FIXED_Q15 || spec.implementation == FIXED_Q31) {
+		const int frac_bits = spec.implementation == FIXED_Q15 ? 15 : 31;
+		block->fixed_sections = FixedSosBank(block->design->sections, channels, frac_bits, spec.full_scale);
+	} else if (spec.implementation == DIRECT && library_design) {
+		for (size_t i = 0; i < channels; i++) {
+			block->filter_implems.push_back(std::make_unique<UnquantDirectFormIir>(
+				num_numer, num_denom, numer_coeff, denom_coeff));
+		}
+	} else if (spec.implementation == SECTIONS_DF1) {
+		block->topology = makeDf1Bank(block->design->sections, channels);
+	} else if (spec.implementation == LATTICE) {
+		block->topology = makeLatticeBank(block->design->sections, channels);
+	} else if (spec.implementation == STATE_VARIABLE) {
+		block->topology = makeStateVariableBank(block->design->sections, channels);
+	} else {
+		const uint64_t precision = spec.precision == AUTO_PRECISION
+			? choosePrecision(block->design->sections) : spec.precision;
+		if (precision == SINGLE_PRECISION) {
+			block->topology = makeSinglePrecisionBank(block->design->sections, channels);
+		} else if (precision == MIXED_PRECISION) {
+			block->topology = makeMixedPrecisionBank(block->design->sections, channels);
+		} else {
+			block->sections = SosBank(block->design->sections, channels);
+		}
+	}
+	const size_t factor = decimationFactor(spec);
+	if (factor > 1) {
+		block->resampler = std::make_unique<PolyphaseResampler>(factor, channels, spec.interpolate);
+	}
+	return block;
+}
@@ -0,0 +1,261 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* Filter design pipeline shared by the plugin and anything else that needs
+* the same filters: analog prototype -> prewarp -> bilinear transform ->
+* implementation.
+*
+* Everything under dsp/ builds into the iir-filter-dsp static library, which
+* needs neither Qt nor a running RTXI: only RTXI's DSP library, for the
+* analog prototypes, the bilinear transform and the direct forms.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+// RTXI's DSP library, installed as rtxi/dsp by RTXI 3 and as DSP before
+#if __has_include(<rtxi/dsp/iir_dsgn.h>)
+#include <rtxi/dsp/iir_dsgn.h>
+#include <rtxi/dsp/dir1_iir.h>
+#include <rtxi/dsp/unq_iir.h>
+#include <rtxi/dsp/buttfunc.h>
+#include <rtxi/dsp/chebfunc.h>
+#include <rtxi/dsp/elipfunc.h>
+#include <rtxi/dsp/bilinear.h>
+#else
+#include <DSP/iir_dsgn.h>
+#include <DSP/dir1_iir.h>
+#include <DSP/unq_iir.h>
+#include <DSP/buttfunc.h>
+#include <DSP/chebfunc.h>
+#include <DSP/elipfunc.h>
+#include <DSP/bilinear.h>
+#endif
+#include "multirate.hpp"
+#include "sos-bank.hpp"
+#include "sos-fixed.hpp"
+#include "sos-precision.hpp"
+#include "sos.hpp"
+#include "topologies.hpp"
+
+#define TWO_PI 6.28318531
+
+enum filter_t : uint64_t {
+	BUTTER=0, CHEBY, ELLIP,
+	NOTCH, // notches at a fundamental and its harmonics, always run as sections
+};
+
+enum implem_t : uint64_t {
+	SECTIONS=0, // cascaded second-order sections, transposed direct form II
+	DIRECT, // single direct form from the DSP library
+	FIXED_Q15, // second-order sections in 16-bit fixed point
+	FIXED_Q31, // second-order sections in 32-bit fixed point
+	SECTIONS_DF1, // second-order sections, direct form I
+	LATTICE, // second-order lattice-ladder sections
+	STATE_VARIABLE, // second-order state-space sections, coupled form
+};
+
+// Everything makeFilter() needs to build a filter, captured by value so that
+// the design can run away from the real-time thread.
+struct FilterSpec {
+	uint64_t filter_type; // type of filter
+	int filter_order; // filter order
+	double passband_ripple; // dB?
+	double stopband_ripple; // dB?
+	double passband_edge; // Hz
+	double stopband_edge; // Hz
+	int ripple_bw_norm; // type of normalization for Chebyshev filter
+	bool quant_enabled; // quantize input signal and coefficients
+	bool predistort_enabled; // predistort frequencies for bilinear transform
+	int input_quan_factor; // quantization factor 2^bits for input signal
+	int coeff_quan_factor; // quantization factor 2^bits for filter coefficients
+	uint64_t implementation; // implem_t, ignored when quantizing
+	double full_scale; // input amplitude at fixed-point full scale, FIXED_Q15/Q31 only
+	double notch_frequency; // fundamental (Hz), NOTCH only
+	int notch_harmonics; // number of notches, at 1, 2, ... times the fundamental
+	double notch_q; // each notch's center frequency over its -3 dB bandwidth
+	double dt; // real-time period of system (s)
+	bool auto_order; // pick type and order with findMinimumOrder (order-search.hpp)
+	bool multirate; // run the filter at a rate decimated to suit the cutoff
+	int decimation; // decimation factor, 0 to pick one from the cutoff
+	bool interpolate; // interpolate back to the tick rate rather than hold
+	uint64_t precision; // precision_t, floating-point SECTIONS only
+
+	bool operator==(const FilterSpec& other) const;
+	bool operator!=(const FilterSpec& other) const { return !(*this == other); }
+};
+
+// input_quan_factor and coeff_quan_factor from a bit count: 2^bits
+inline int quantization_factor(int64_t bits) {
+	return 1 << std::clamp<int64_t>(bits, 1, 30);
+}
+
+// and back: the bits for a factor, or -1 if no setting gives that factor
+inline int64_t quantization_bits(int factor) {
+	for (int64_t bits = 1; bits <= 30; bits++) {
+		if (quantization_factor(bits) == factor) { return bits; }
+	}
+	return -1;
+}
+
+struct FilterSpecHash {
+	size_t operator()(const FilterSpec& spec) const;
+};
+
+// The spec with every parameter the filter ignores reset to zero, so that two
+// specs describing the same filter compare equal (e.g. a Butterworth with
+// different stopband edges).
+FilterSpec canonicalSpec(const FilterSpec& spec);
+
+// Only what the design pipeline reads: the canonical spec without the
+// quantization and implementation choices, which are applied afterwards.
+FilterSpec designKey(const FilterSpec& spec);
+
+constexpr size_t MAX_DECIMATION = 64;
+// the decimated rate is at least this many times the highest edge or notch
+constexpr double DECIMATION_MARGIN = 8;
+
+// How many ticks the filter runs every one of: 1 unless multirate, otherwise
+// the requested factor or the largest that keeps DECIMATION_MARGIN.
+size_t decimationFactor(const FilterSpec& spec);
+
+// The spec the filter is designed from: dt scaled by the decimation factor
+// and multirate off.
+FilterSpec decimatedSpec(const FilterSpec& spec);
+
+// Output of the design pipeline. Immutable once made, so it can be cached and
+// shared between filters.
+struct FilterDesign {
+	std::vector<double> numer_coeff; // direct form numerator
+	std::vector<double> denom_coeff; // direct form denominator, including the leading one
+	std::vector<Biquad> sections; // the same filter as second-order sections
+};
+
+std::shared_ptr<const FilterDesign> designFilter(const FilterSpec& spec);
+
+// A finished filter for one or more channels sharing the same design. One of
+// sections or fixed_sections is populated, or there is one filter_implems
+// entry per channel, or a topology. With a resampler, all of them run at the
+// decimated rate.
+struct FilterBlock {
+	std::shared_ptr<const FilterDesign> design;
+	std::vector<std::unique_ptr<FilterImplementation>> filter_implems;
+	SosBank sections;
+	FixedSosBank fixed_sections;
+	std::unique_ptr<TopologyBank> topology;
+	std::unique_ptr<PolyphaseResampler> resampler;
+
+	// one sample per channel
+	void process(const double* in, double* out) {
+		if (resampler != nullptr) {
+			if (resampler->decimate(in)) { processAtRate(resampler->decimated(), resampler->filtered()); }
+			resampler->interpolate(out);
+			return;
+		}
+		processAtRate(in, out);
+	}
+
+	// one sample per channel at the rate the design is for
+	void processAtRate(const double* in, double* out) {
+		if (topology != nullptr) {
+			topology->process(in, out);
+			return;
+		}
+		if (fixed_sections.numChannels() > 0) {
+			fixed_sections.process(in, out);
+			return;
+		}
+		if (filter_implems.empty()) {
+			sections.process(in, out);
+			return;
+		}
+		for (size_t i = 0; i < filter_implems.size(); i++) {
+			out[i] = filter_implems[i]->ProcessSample(in[i]);
+		}
+	}
+
+	// Start from the state a constant input would leave behind, so a filter
+	// swapped in mid-stream has no start-up transient. Only the floating-point
+	// sections support it; the other implementations start from zero.
+	void setSteadyState(const double* in);
+
+	// Clear a state that has gone wrong (see isHealthy() in numeric-health.hpp)
+	// without allocating: zero, then the steady state for in if it is itself
+	// healthy. False if the implementation cannot be cleared in place (the
+	// DSP library's direct forms); that block has to be replaced.
+	bool recover(const double* in);
+
+	size_t numChannels() const {
+		if (topology != nullptr) { return topology->numChannels(); }
+		if (fixed_sections.numChannels() > 0) { return fixed_sections.numChannels(); }
+		return filter_implems.empty() ? sections.numChannels() : filter_implems.size();
+	}
+
+	// Only the floating-point sections, at the tick rate: the block's whole
+	// state is what sections.getState() captures.
+	bool plainSections() const {
+		return topology == nullptr && resampler == nullptr && fixed_sections.numChannels() == 0
+			&& filter_implems.empty();
+	}
+
+	// frames ticks, each frame holding one sample per channel; in and out may
+	// be the same buffer
+	void process(const double* in, double* out, size_t frames) {
+		if (resampler != nullptr) {
+			const size_t channels = resampler->numChannels();
+			for (size_t f = 0; f < frames; f++) {
+				process(in + f * channels, out + f * channels);
+			}
+			return;
+		}
+		if (topology != nullptr) {
+			topology->process(in, out, frames);
+			return;
+		}
+		if (fixed_sections.numChannels() > 0) {
+			fixed_sections.process(in, out, frames);
+			return;
+		}
+		if (filter_implems.empty()) {
+			sections.process(in, out, frames);
+			return;
+		}
+		const size_t channels = filter_implems.size();
+		for (size_t f = 0; f < frames; f++) {
+			process(in + f * channels, out + f * channels);
+		}
+	}
+};
+
+// Design and build in one go.
+std::unique_ptr<FilterBlock> makeFilter(const FilterSpec& spec, size_t channels = 1);
+// Build the implementation (and its state) for an existing design.
+std::unique_ptr<FilterBlock> makeFilter(std::shared_ptr<const FilterDesign> design,
+	const FilterSpec& spec, size_t channels = 1);
+
+// Factor the prewarped analog prototype into digital second-order sections
+// by mapping each pole and zero through the bilinear transform individually,
+// which avoids expanding a high-order polynomial.
+std::vector<Biquad> makeSections(FilterTransFunc* analog_filter, const FilterSpec& spec);
+
+// One notch section per harmonic below Nyquist, tuned exactly at its
+// frequency (the bilinear transform is prewarped per notch).
+std::vector<Biquad> makeNotchSections(const FilterSpec& spec);
@@ -0,0 +1,76 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <chrono>
+#include <random>
+#include "implementation-timing.hpp"
+#include "numeric-health.hpp"
+
+std::vector<ImplementationTiming> timeImplementations(std::shared_ptr<const FilterDesign> design,
+	const FilterSpec& spec, size_t channels, size_t ticks) {
+	using clock = std::chrono::steady_clock;
+	const ScopedFlushToZero flush_to_zero;
+	std::vector<double> input(ticks * channels);
+	std::mt19937 generator(12345);
+	std::normal_distribution<double> noise(0.0, 1.0);
+	for (double& v : input) { v = noise(generator); }
+	std::vector<double> output(channels);
+
+	std::vector<ImplementationTiming> timings;
+	for (uint64_t implementation : {SECTIONS, DIRECT, FIXED_Q15, FIXED_Q31, SECTIONS_DF1, LATTICE, STATE_VARIABLE}) {
+		for (uint64_t precision : {DOUBLE_PRECISION, SINGLE_PRECISION, MIXED_PRECISION}) {
+			FilterSpec variant = spec;
+			variant.quant_enabled = false;
+			variant.implementation = implementation;
+			variant.precision = precision;
+			// notches have no library direct form, and only sections have a precision
+			const FilterSpec canonical = canonicalSpec(variant);
+			if (canonical.implementation != implementation || canonical.precision != precision) { continue; }
+			std::unique_ptr<FilterBlock> block = makeFilter(design, variant, channels);
+			// one pass to warm the caches, one timed
+			for (size_t pass = 0; pass < 2; pass++) {
+				const auto start = clock::now();
+				for (size_t t = 0; t < ticks; t++) { block->process(input.data() + t * channels, output.data()); }
+				const double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+				if (pass == 1) { timings.push_back({implementation, precision, ns / static_cast<double>(ticks * channels)}); }
+			}
+		}
+	}
+	return timings;
+}
+
+const char* implementationName(uint64_t implementation) {
+	switch (implementation) {
+		case SECTIONS: return "sections";
+		case DIRECT: return "direct";
+		case FIXED_Q15: return "fixed-q15";
+		case FIXED_Q31: return "fixed-q31";
+		case SECTIONS_DF1: return "df1";
+		case LATTICE: return "lattice";
+		default: return "state-variable";
+	}
+}
+
+const char* precisionName(uint64_t precision) {
+	switch (precision) {
+		case DOUBLE_PRECISION: return "double";
+		case SINGLE_PRECISION: return "single";
+		case MIXED_PRECISION: return "mixed";
+		default: return "auto";
+	}
+}
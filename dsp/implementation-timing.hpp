@@ -0,0 +1,49 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* timeImplementations
+* Measures what each implementation costs for one design on this machine, so
+* the choice between speed and numerical robustness can be made with numbers
+* for the actual order, channel count and sample rate. Every implementation
+* is built from the same design and fed the same noise one tick at a time,
+* as the real-time thread does, with subnormals flushed as they are there.
+* Takes a few milliseconds; meant for the design thread or a tool.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "filter-design.hpp"
+
+struct ImplementationTiming {
+	uint64_t implementation; // implem_t
+	uint64_t precision; // precision_t, SECTIONS only
+	double ns_per_sample; // per channel
+};
+
+// every implementation the spec can run as, in implem_t order, with SECTIONS
+// once for each concrete precision
+std::vector<ImplementationTiming> timeImplementations(std::shared_ptr<const FilterDesign> design,
+	const FilterSpec& spec, size_t channels, size_t ticks = 4096);
+
+const char* implementationName(uint64_t implementation);
+const char* precisionName(uint64_t precision);
@@ -0,0 +1,144 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <algorithm>
+#include <cmath>
+#include "multirate.hpp"
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+
+// Blackman-windowed sinc with its cutoff at the decimated Nyquist rate,
+// normalized to unity gain at DC
+std::vector<double> antiAliasTaps(size_t factor, size_t length) {
+	std::vector<double> taps(length);
+	const double center = 0.5 * static_cast<double>(length - 1);
+	const double cutoff = 0.5 / static_cast<double>(factor); // cycles per tick
+	double sum = 0;
+	for (size_t k = 0; k < length; k++) {
+		const double t = static_cast<double>(k) - center;
+		const double sinc = t == 0 ? 1 : std::sin(2 * PI * cutoff * t) / (2 * PI * cutoff * t);
+		const double phase = 2 * PI * static_cast<double>(k) / static_cast<double>(length - 1);
+		const double window = 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2 * phase);
+		taps[k] = sinc * window;
+		sum += taps[k];
+	}
+	for (double& tap : taps) { tap /= sum; }
+	return taps;
+}
+
+// The interpolator's taps: each phase scaled to unity gain at DC on its own,
+// so a constant comes back out without ripple at the decimated rate
+std::vector<double> phaseNormalized(const std::vector<double>& taps, size_t factor) {
+	std::vector<double> result(taps);
+	for (size_t p = 0; p < factor; p++) {
+		double sum = 0;
+		for (size_t k = p; k < taps.size(); k += factor) { sum += taps[k]; }
+		for (size_t k = p; k < taps.size(); k += factor) { result[k] /= sum; }
+	}
+	return result;
+}
+
+} // namespace
+
+PolyphaseResampler::PolyphaseResampler(size_t factor, size_t channels, bool interpolate)
+	: rate_factor(std::max<size_t>(factor, 1)), num_channels(channels), interpolating(interpolate),
+	taps(antiAliasTaps(rate_factor, TAPS_PER_PHASE * rate_factor)),
+	interp_taps(phaseNormalized(taps, rate_factor)),
+	sums(TAPS_PER_PHASE * channels, 0.0), history(TAPS_PER_PHASE * channels, 0.0),
+	low_in(channels, 0.0), low_out(channels, 0.0)
+{
+}
+
+// Decimated frame m is sum_k taps[k] * x[(m + 1) * factor - 1 - k], so the
+// frame at phase r feeds taps[factor - 1 - r + j * factor] into the sum for
+// frame m + j. The sum at sum_head is complete after the last phase.
+bool PolyphaseResampler::decimate(const double* in) {
+	const size_t first_tap = rate_factor - 1 - in_phase;
+	for (size_t j = 0; j < TAPS_PER_PHASE; j++) {
+		const double tap = taps[first_tap + j * rate_factor];
+		double* sum = sums.data() + ((sum_head + j) % TAPS_PER_PHASE) * num_channels;
+		for (size_t ch = 0; ch < num_channels; ch++) { sum[ch] += tap * in[ch]; }
+	}
+	if (++in_phase < rate_factor) { return false; }
+
+	in_phase = 0;
+	double* done = sums.data() + sum_head * num_channels;
+	std::copy(done, done + num_channels, low_in.begin());
+	std::fill(done, done + num_channels, 0.0);
+	sum_head = (sum_head + 1) % TAPS_PER_PHASE;
+	fresh = true;
+	return true;
+}
+
+// Output frame r ticks after low-rate output m is
+// sum_j interp_taps[r + j * factor] * y[m - j]: the same filter run over y
+// with factor - 1 zeros stuffed between samples.
+void PolyphaseResampler::interpolate(double* out) {
+	if (fresh) {
+		history_head = (history_head + TAPS_PER_PHASE - 1) % TAPS_PER_PHASE;
+		std::copy(low_out.begin(), low_out.end(), history.begin() + history_head * num_channels);
+		out_phase = 0;
+		fresh = false;
+	}
+	if (!interpolating) {
+		const double* newest = history.data() + history_head * num_channels;
+		std::copy(newest, newest + num_channels, out);
+		return;
+	}
+	std::fill(out, out + num_channels, 0.0);
+	for (size_t j = 0; j < TAPS_PER_PHASE; j++) {
+		const double tap = interp_taps[out_phase + j * rate_factor];
+		const double* y = history.data() + ((history_head + j) % TAPS_PER_PHASE) * num_channels;
+		for (size_t ch = 0; ch < num_channels; ch++) { out[ch] += tap * y[ch]; }
+	}
+	// holds at the last phase until the next low-rate output arrives
+	if (out_phase + 1 < rate_factor) { out_phase++; }
+}
+
+void PolyphaseResampler::setSteadyState(const double* input, double gain) {
+	// the sum for frame sum_head + j has seen every tap from
+	// (j + 1) * factor - in_phase on
+	for (size_t j = 0; j < TAPS_PER_PHASE; j++) {
+		double seen = 0;
+		for (size_t k = (j + 1) * rate_factor - in_phase; k < taps.size(); k++) { seen += taps[k]; }
+		double* sum = sums.data() + ((sum_head + j) % TAPS_PER_PHASE) * num_channels;
+		for (size_t ch = 0; ch < num_channels; ch++) { sum[ch] = seen * input[ch]; }
+	}
+	for (size_t j = 0; j < TAPS_PER_PHASE; j++) {
+		double* y = history.data() + j * num_channels;
+		for (size_t ch = 0; ch < num_channels; ch++) { y[ch] = gain * input[ch]; }
+	}
+	fresh = false;
+}
+
+void PolyphaseResampler::reset() {
+	std::fill(sums.begin(), sums.end(), 0.0);
+	std::fill(history.begin(), history.end(), 0.0);
+	in_phase = 0;
+	out_phase = 0;
+	sum_head = 0;
+	history_head = 0;
+	fresh = false;
+}
+
+size_t PolyphaseResampler::delay() const {
+	const size_t fir_delay = (taps.size() - 1) / 2;
+	return interpolating ? 2 * fir_delay : fir_delay;
+}
@@ -0,0 +1,80 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* PolyphaseResampler
+* Wraps a filter so that it runs at 1/factor of the tick rate: a polyphase
+* FIR decimator in front, and an optional polyphase FIR interpolator behind
+* (otherwise the low-rate output is held). Both share one windowed-sinc
+* anti-aliasing filter of TAPS_PER_PHASE * factor taps, with each of the
+* interpolator's phases rescaled to unity DC gain. The decimator keeps
+* one running sum per phase, so each tick does TAPS_PER_PHASE multiplies per
+* channel on each side however large the factor is; nothing is done in bursts
+* except the wrapped filter itself, once every factor ticks.
+*
+* Per tick:
+*   if (resampler.decimate(in)) { filter(resampler.decimated(), resampler.filtered()); }
+*   resampler.interpolate(out);
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class PolyphaseResampler {
+	public:
+		static constexpr size_t TAPS_PER_PHASE = 8;
+
+		PolyphaseResampler(size_t factor, size_t channels, bool interpolate);
+
+		// feed one full-rate frame; true when a decimated frame is ready
+		bool decimate(const double* in);
+		// the decimated frame, valid after decimate() returns true
+		const double* decimated() const { return low_in.data(); }
+		// where the wrapped filter puts its output for the decimated frame
+		double* filtered() { return low_out.data(); }
+		// one full-rate output frame
+		void interpolate(double* out);
+
+		// as if input[channel] had been applied forever, and the wrapped
+		// filter had answered with gain * input[channel]
+		void setSteadyState(const double* input, double gain);
+		void reset();
+
+		size_t factor() const { return rate_factor; }
+		size_t numChannels() const { return num_channels; }
+		// group delay of the decimator and interpolator together, in ticks
+		size_t delay() const;
+
+	private:
+		size_t rate_factor;
+		size_t num_channels;
+		bool interpolating;
+		std::vector<double> taps; // TAPS_PER_PHASE * factor, sum 1
+		std::vector<double> interp_taps; // taps with every phase summing to 1
+		std::vector<double> sums; // [TAPS_PER_PHASE][channel] running decimator outputs
+		std::vector<double> history; // [TAPS_PER_PHASE][channel] recent low-rate outputs
+		std::vector<double> low_in; // [channel]
+		std::vector<double> low_out; // [channel]
+		size_t in_phase = 0; // frames fed into the current decimated frame
+		size_t out_phase = 0; // frames output since the newest low-rate output
+		size_t sum_head = 0; // slot of the sum completed next
+		size_t history_head = 0; // slot of the newest low-rate output
+		bool fresh = false; // low_out holds an output not yet in history
+};
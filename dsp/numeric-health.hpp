@@ -0,0 +1,87 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* ScopedFlushToZero, isHealthy
+* Keeps the real-time arithmetic at a flat cost. As a filter's output decays
+* after its input goes quiet, the state becomes subnormal, and on x86 every
+* operation on a subnormal takes a microcode assist a hundred times slower
+* than usual. ScopedFlushToZero sets FTZ and DAZ in MXCSR (which the SSE and
+* AVX kernels both obey) for its lifetime and puts back whatever the thread
+* had before, so other code sharing the thread is unaffected. It does nothing
+* on other architectures.
+*
+* isHealthy() is the per-tick check for a filter that has gone wrong: a NaN
+* or infinity, or a value past HEALTH_LIMIT from a state that has blown up.
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#define NUMERIC_HEALTH_MXCSR 1
+#endif
+
+// far beyond any signal the filter is meant for
+constexpr double HEALTH_LIMIT = 1e15;
+
+class ScopedFlushToZero {
+	public:
+		ScopedFlushToZero() {
+#ifdef NUMERIC_HEALTH_MXCSR
+			saved = _mm_getcsr();
+			// setting MXCSR stalls the pipeline, so only when it changes
+			if ((saved & FTZ_DAZ) != FTZ_DAZ) { _mm_setcsr(saved | FTZ_DAZ); }
+#endif
+		}
+		~ScopedFlushToZero() {
+#ifdef NUMERIC_HEALTH_MXCSR
+			if ((saved & FTZ_DAZ) != FTZ_DAZ) { _mm_setcsr(saved); }
+#endif
+		}
+		ScopedFlushToZero(const ScopedFlushToZero&) = delete;
+		ScopedFlushToZero& operator=(const ScopedFlushToZero&) = delete;
+
+		static bool supported() {
+#ifdef NUMERIC_HEALTH_MXCSR
+			return true;
+#else
+			return false;
+#endif
+		}
+
+	private:
+#ifdef NUMERIC_HEALTH_MXCSR
+		static constexpr unsigned FTZ_DAZ = 0x8040; // flush-to-zero | denormals-are-zero
+		unsigned saved;
+#endif
+};
+
+// every value finite and within HEALTH_LIMIT; no branches, so the cost
+// does not depend on the values
+inline bool isHealthy(const double* values, size_t count) {
+	bool healthy = true;
+	for (size_t i = 0; i < count; i++) {
+		// false for NaN as well
+		healthy &= std::fabs(values[i]) <= HEALTH_LIMIT;
+	}
+	return healthy;
+}
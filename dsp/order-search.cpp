@@ -0,0 +1,152 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <thread>
+#include "order-search.hpp"
+
+namespace {
+
+using cplx = std::complex<double>;
+
+constexpr size_t GRID_POINTS = 512; // frequencies checked per band
+// slack for designs that sit exactly on the mask, e.g. a Butterworth is
+// 3.01 dB down at its edge against the default 3 dB ripple
+constexpr double MASK_TOLERANCE_DB = 0.05;
+
+double gainDb(const std::vector<Biquad>& sections, double freq, double dt) {
+	const cplx z1 = std::polar(1.0, -TWO_PI * freq * dt); // z^-1
+	const cplx z2 = z1 * z1;
+	cplx response = 1;
+	for (const Biquad& c : sections) {
+		response *= (c.b0 + c.b1 * z1 + c.b2 * z2) / (1.0 + c.a1 * z1 + c.a2 * z2);
+	}
+	return 20 * std::log10(std::abs(response));
+}
+
+// both poles of 1 + a1 z^-1 + a2 z^-2 strictly inside the unit circle
+bool isStable(const Biquad& c) {
+	return std::abs(c.a2) < 1 && std::abs(c.a1) < 1 + c.a2;
+}
+
+// how far inside the mask a check is; negative when it fails
+double margin(const ResponseCheck& check, const FilterSpec& spec) {
+	if (!check.stable) { return -std::numeric_limits<double>::infinity(); }
+	return std::min({spec.passband_ripple - check.passband_loss, -check.passband_gain,
+		check.stopband_attenuation - spec.stopband_ripple});
+}
+
+struct Candidate {
+	FilterSpec spec;
+	std::shared_ptr<const FilterDesign> design;
+	ResponseCheck check;
+};
+
+size_t cost(const Candidate& candidate) {
+	return static_cast<size_t>(candidate.spec.filter_order + 1) / 2; // sections
+}
+
+bool cheaper(const Candidate& a, const Candidate& b) {
+	if (cost(a) != cost(b)) { return cost(a) < cost(b); }
+	if (a.spec.filter_order != b.spec.filter_order) { return a.spec.filter_order < b.spec.filter_order; }
+	return a.spec.filter_type < b.spec.filter_type;
+}
+
+} // namespace
+
+ResponseCheck checkResponse(const std::vector<Biquad>& sections, const FilterSpec& full_spec) {
+	ResponseCheck check{0, -std::numeric_limits<double>::infinity(),
+		std::numeric_limits<double>::infinity(), true, false};
+	check.stable = std::all_of(sections.begin(), sections.end(), isStable);
+
+	// a multirate design is checked up to its own Nyquist; the resampler's
+	// anti-aliasing filter takes care of the rest
+	const FilterSpec spec = decimatedSpec(full_spec);
+	const double nyquist = 0.5 / spec.dt;
+	const double passband_edge = std::min(spec.passband_edge, nyquist);
+	for (size_t i = 0; i < GRID_POINTS; i++) {
+		const double gain = gainDb(sections, passband_edge * i / (GRID_POINTS - 1), spec.dt);
+		check.passband_loss = std::max(check.passband_loss, -gain);
+		check.passband_gain = std::max(check.passband_gain, gain);
+	}
+	if (spec.stopband_edge < nyquist) {
+		for (size_t i = 0; i < GRID_POINTS; i++) {
+			const double freq = spec.stopband_edge + (nyquist - spec.stopband_edge) * i / (GRID_POINTS - 1);
+			check.stopband_attenuation = std::min(check.stopband_attenuation, -gainDb(sections, freq, spec.dt));
+		}
+	}
+	check.passes = check.stable
+		&& check.passband_loss <= spec.passband_ripple + MASK_TOLERANCE_DB
+		&& check.passband_gain <= MASK_TOLERANCE_DB
+		&& check.stopband_attenuation >= spec.stopband_ripple - MASK_TOLERANCE_DB;
+	return check;
+}
+
+OrderSearchResult findMinimumOrder(const FilterSpec& spec, unsigned threads) {
+	FilterSpec manual = spec;
+	manual.auto_order = false;
+	// every candidate runs at the rate picked for the whole mask
+	manual.decimation = static_cast<int>(decimationFactor(spec));
+	const double nyquist = 0.5 / decimatedSpec(spec).dt;
+	if (!(spec.passband_edge > 0 && spec.passband_edge < spec.stopband_edge && spec.stopband_edge < nyquist)) {
+		std::shared_ptr<const FilterDesign> design = designFilter(manual);
+		return {manual, design, checkResponse(design->sections, manual), false};
+	}
+
+	std::vector<Candidate> candidates;
+	for (uint64_t type : {BUTTER, CHEBY, ELLIP}) {
+		// a first-order elliptical filter is no different from the others
+		for (int order = type == ELLIP ? 2 : 1; order <= MAX_AUTO_ORDER; order++) {
+			Candidate candidate{manual, nullptr, {}};
+			candidate.spec.filter_type = type;
+			candidate.spec.filter_order = order;
+			candidates.push_back(candidate);
+		}
+	}
+
+	std::atomic<size_t> next{0};
+	auto worker = [&]() {
+		for (size_t i = next++; i < candidates.size(); i = next++) {
+			candidates[i].design = designFilter(candidates[i].spec);
+			candidates[i].check = checkResponse(candidates[i].design->sections, candidates[i].spec);
+		}
+	};
+	if (threads == 0) { threads = std::max(1u, std::thread::hardware_concurrency()); }
+	std::vector<std::thread> pool;
+	const size_t num_threads = std::min<size_t>(threads, candidates.size());
+	for (size_t i = 1; i < num_threads; i++) { pool.emplace_back(worker); }
+	worker();
+	for (std::thread& thread : pool) { thread.join(); }
+
+	const Candidate* best = nullptr;
+	for (const Candidate& candidate : candidates) {
+		if (candidate.check.passes && (best == nullptr || cheaper(candidate, *best))) { best = &candidate; }
+	}
+	if (best != nullptr) { return {best->spec, best->design, best->check, true}; }
+
+	// nothing passes: hand back whichever came closest
+	best = &candidates.front();
+	for (const Candidate& candidate : candidates) {
+		if (margin(candidate.check, spec) > margin(best->check, spec)) { best = &candidate; }
+	}
+	return {best->spec, best->design, best->check, false};
+}
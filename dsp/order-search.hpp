@@ -0,0 +1,58 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* Minimum-order search
+* Designs every Butterworth, Chebyshev and elliptical filter up to
+* MAX_AUTO_ORDER on worker threads, measures each digital response against
+* the spec's mask (at most passband_ripple dB of loss up to the passband
+* edge, at least stopband_ripple dB of attenuation from the stopband edge to
+* Nyquist) and keeps the cheapest that passes: fewest sections, then lowest
+* order, then Butterworth before Chebyshev before elliptical.
+*/
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "filter-design.hpp"
+
+constexpr int MAX_AUTO_ORDER = 20;
+
+// how a design measures up against the mask
+struct ResponseCheck {
+	double passband_loss; // worst loss below 0 dB in the passband, dB
+	double passband_gain; // worst gain above 0 dB in the passband, dB
+	double stopband_attenuation; // least attenuation in the stopband, dB
+	bool stable;
+	bool passes;
+};
+
+ResponseCheck checkResponse(const std::vector<Biquad>& sections, const FilterSpec& spec);
+
+struct OrderSearchResult {
+	FilterSpec spec; // spec.filter_type and filter_order chosen, auto_order cleared
+	std::shared_ptr<const FilterDesign> design;
+	ResponseCheck check;
+	bool meets_spec; // if false, design is the candidate that came closest
+};
+
+// Spec edges must satisfy 0 < passband_edge < stopband_edge < Nyquist;
+// otherwise nothing is designed in parallel and the spec's own type and order
+// come back, marked as not meeting it. threads = 0 uses every core.
+OrderSearchResult findMinimumOrder(const FilterSpec& spec, unsigned threads = 0);
@@ -0,0 +1,102 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <algorithm>
+#include <cmath>
+#include "response.hpp"
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+// floor for divisors: a zero on the unit circle has no defined group delay,
+// and a phasor that has collapsed to zero stays there
+constexpr double TINY = 1e-300;
+
+} // namespace
+
+FrequencyResponse computeResponse(const std::vector<Biquad>& sections, double dt,
+	size_t points, double decades) {
+	FrequencyResponse response;
+	if (points < 2 || dt <= 0) { return response; }
+	const double nyquist = 0.5 / dt;
+	response.freq.resize(points);
+	for (size_t i = 0; i < points; i++) {
+		const double exponent = decades * (static_cast<double>(i) / (points - 1) - 1);
+		response.freq[i] = nyquist * std::pow(10.0, exponent);
+	}
+
+	// e^{-jw} and e^{-2jw} for every point
+	std::vector<double> cos1(points), sin1(points), cos2(points), sin2(points);
+	for (size_t i = 0; i < points; i++) {
+		const double w = 2 * PI * response.freq[i] * dt;
+		cos1[i] = std::cos(w);
+		sin1[i] = std::sin(w);
+		cos2[i] = std::cos(2 * w);
+		sin2[i] = std::sin(2 * w);
+	}
+
+	// |H|^2, the direction of H (as a phasor of arbitrary length), and the
+	// delay in samples
+	std::vector<double> power(points, 1.0), re(points, 1.0), im(points, 0.0), delay(points, 0.0);
+	for (const Biquad& c : sections) {
+		for (size_t i = 0; i < points; i++) {
+			const double nr = c.b0 + c.b1 * cos1[i] + c.b2 * cos2[i];
+			const double ni = -(c.b1 * sin1[i] + c.b2 * sin2[i]);
+			const double dr = 1 + c.a1 * cos1[i] + c.a2 * cos2[i];
+			const double di = -(c.a1 * sin1[i] + c.a2 * sin2[i]);
+			const double n2 = nr * nr + ni * ni;
+			const double d2 = dr * dr + di * di;
+			power[i] *= n2 / d2;
+
+			// group delay of a polynomial p(e^{-jw}) is Re(sum k p_k e^{-jkw} / p)
+			const double knr = c.b1 * cos1[i] + 2 * c.b2 * cos2[i];
+			const double kni = -(c.b1 * sin1[i] + 2 * c.b2 * sin2[i]);
+			const double kdr = c.a1 * cos1[i] + 2 * c.a2 * cos2[i];
+			const double kdi = -(c.a1 * sin1[i] + 2 * c.a2 * sin2[i]);
+			delay[i] += (knr * nr + kni * ni) / std::max(n2, TINY) - (kdr * dr + kdi * di) / d2;
+
+			// H *= N * conj(D), rescaled so it never under- or overflows;
+			// division only, so the loop needs no libm call
+			const double sr = nr * dr + ni * di;
+			const double si = ni * dr - nr * di;
+			const double hr = re[i] * sr - im[i] * si;
+			const double hi = re[i] * si + im[i] * sr;
+			const double scale = std::max(std::max(std::fabs(hr), std::fabs(hi)), TINY);
+			re[i] = hr / scale;
+			im[i] = hi / scale;
+		}
+	}
+
+	response.magnitude.resize(points);
+	response.phase.resize(points);
+	response.group_delay.resize(points);
+	double unwrap = 0;
+	double previous = 0;
+	for (size_t i = 0; i < points; i++) {
+		response.magnitude[i] = std::max(MIN_RESPONSE_DB, 10 * std::log10(power[i]));
+		double phase = std::atan2(im[i], re[i]) + unwrap;
+		if (i > 0) {
+			while (phase - previous > PI) { phase -= 2 * PI; unwrap -= 2 * PI; }
+			while (phase - previous < -PI) { phase += 2 * PI; unwrap += 2 * PI; }
+		}
+		previous = phase;
+		response.phase[i] = phase * 180 / PI;
+		response.group_delay[i] = delay[i] * dt;
+	}
+	return response;
+}
@@ -0,0 +1,45 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* FrequencyResponse
+* Magnitude, phase and group delay of a cascade of second-order sections on a
+* log-spaced frequency grid up to Nyquist. The work is laid out
+* structure-of-arrays, one pass over every frequency per section, so the
+* inner loops vectorize over frequency points. Too slow for the real-time
+* thread; meant for the design thread or a tool.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "sos.hpp"
+
+struct FrequencyResponse {
+	std::vector<double> freq; // Hz, ascending
+	std::vector<double> magnitude; // dB, floored at MIN_RESPONSE_DB
+	std::vector<double> phase; // degrees, unwrapped
+	std::vector<double> group_delay; // s
+};
+
+constexpr double MIN_RESPONSE_DB = -300; // stands in for exact zeros
+
+// points frequencies from Nyquist / 10^decades up to Nyquist
+FrequencyResponse computeResponse(const std::vector<Biquad>& sections, double dt,
+	size_t points = 512, double decades = 4);
@@ -0,0 +1,315 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <utility>
+#include "sos-bank.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SOS_BANK_X86 1
+#endif
+
+namespace {
+
+constexpr size_t ALIGNMENT = 64; // one cache line, one AVX-512 register
+constexpr size_t MAX_LANES = 8; // doubles per AVX-512 register
+constexpr size_t MAX_SPECIALIZED_SECTIONS = 10; // orders 1-20
+
+typedef double Lanes4 __attribute__((vector_size(4 * sizeof(double))));
+typedef double Lanes8 __attribute__((vector_size(8 * sizeof(double))));
+
+// One tick for every channel. V is double or a GCC vector of doubles; the
+// instantiations below are compiled for the matching instruction set.
+// Multiplies and adds are kept separate so every width rounds like
+// SosCascade does.
+template<typename V, size_t LANES>
+inline __attribute__((always_inline)) size_t tickKernel(const Biquad* sections,
+	size_t num_sections, double* state, size_t stride, const double* in,
+	double* out, size_t first, size_t channels) {
+	size_t ch = first;
+	for (; ch + LANES <= channels; ch += LANES) {
+		V x;
+		std::memcpy(&x, in + ch, sizeof(V));
+		double* z = state + ch;
+		for (size_t s = 0; s < num_sections; ++s, z += 2 * stride) {
+			const Biquad& c = sections[s];
+			V* z1 = reinterpret_cast<V*>(z);
+			V* z2 = reinterpret_cast<V*>(z + stride);
+			const V y = c.b0 * x + *z1;
+			*z1 = c.b1 * x - c.a1 * y + *z2;
+			*z2 = c.b2 * x - c.a2 * y;
+			x = y;
+		}
+		std::memcpy(out + ch, &x, sizeof(V));
+	}
+	return ch;
+}
+
+// tickKernel with the section count N fixed at compile time. The section
+// loop unrolls completely: every coefficient and state row sits at a constant
+// offset, and there is no loop counter or bound to check. Same operations in
+// the same order, so the results match tickKernel's exactly.
+template<typename V, size_t LANES, size_t N>
+inline __attribute__((always_inline)) size_t tickSections(const Biquad* sections,
+	double* state, size_t stride, const double* in, double* out, size_t first,
+	size_t channels) {
+	size_t ch = first;
+	for (; ch + LANES <= channels; ch += LANES) {
+		V x;
+		std::memcpy(&x, in + ch, sizeof(V));
+		double* z = state + ch;
+#pragma GCC unroll 16
+		for (size_t s = 0; s < N; ++s) {
+			V* z1 = reinterpret_cast<V*>(z + 2 * s * stride);
+			V* z2 = reinterpret_cast<V*>(z + (2 * s + 1) * stride);
+			const Biquad& c = sections[s];
+			const V y = c.b0 * x + *z1;
+			*z1 = c.b1 * x - c.a1 * y + *z2;
+			*z2 = c.b2 * x - c.a2 * y;
+			x = y;
+		}
+		std::memcpy(out + ch, &x, sizeof(V));
+	}
+	return ch;
+}
+
+// Many ticks for every channel, frames stored one after another with the
+// channels of a frame contiguous. K sections at a time keep their state in
+// registers for the whole block, giving the CPU K independent recursions to
+// overlap; out doubles as the buffer between groups.
+template<typename V, size_t K>
+inline __attribute__((always_inline)) void blockGroup(const Biquad* sections,
+	double* z, size_t stride, const double* src, double* out, size_t ch,
+	size_t channels, size_t frames) {
+	V z1[K];
+	V z2[K];
+	for (size_t k = 0; k < K; ++k) {
+		std::memcpy(&z1[k], z + 2 * k * stride, sizeof(V));
+		std::memcpy(&z2[k], z + (2 * k + 1) * stride, sizeof(V));
+	}
+	for (size_t f = 0; f < frames; ++f) {
+		V x;
+		std::memcpy(&x, src + f * channels + ch, sizeof(V));
+#pragma GCC unroll 4
+		for (size_t k = 0; k < K; ++k) {
+			const Biquad& c = sections[k];
+			const V y = c.b0 * x + z1[k];
+			z1[k] = c.b1 * x - c.a1 * y + z2[k];
+			z2[k] = c.b2 * x - c.a2 * y;
+			x = y;
+		}
+		std::memcpy(out + f * channels + ch, &x, sizeof(V));
+	}
+	for (size_t k = 0; k < K; ++k) {
+		std::memcpy(z + 2 * k * stride, &z1[k], sizeof(V));
+		std::memcpy(z + (2 * k + 1) * stride, &z2[k], sizeof(V));
+	}
+}
+
+template<typename V, size_t LANES>
+inline __attribute__((always_inline)) size_t blockKernel(const Biquad* sections,
+	size_t num_sections, double* state, size_t stride, const double* in,
+	double* out, size_t first, size_t channels, size_t frames) {
+	size_t ch = first;
+	for (; ch + LANES <= channels; ch += LANES) {
+		const double* src = in;
+		for (size_t s = 0; s < num_sections; s += 4, src = out) {
+			double* z = state + 2 * s * stride + ch;
+			switch (std::min<size_t>(num_sections - s, 4)) {
+				case 1: blockGroup<V, 1>(sections + s, z, stride, src, out, ch, channels, frames); break;
+				case 2: blockGroup<V, 2>(sections + s, z, stride, src, out, ch, channels, frames); break;
+				case 3: blockGroup<V, 3>(sections + s, z, stride, src, out, ch, channels, frames); break;
+				default: blockGroup<V, 4>(sections + s, z, stride, src, out, ch, channels, frames); break;
+			}
+		}
+		if (num_sections == 0 && in != out) {
+			for (size_t f = 0; f < frames; ++f) {
+				std::memcpy(out + f * channels + ch, in + f * channels + ch, sizeof(V));
+			}
+		}
+	}
+	return ch;
+}
+
+void scalarTick(const Biquad* sections, size_t num_sections, double* state,
+	size_t stride, const double* in, double* out, size_t channels) {
+	tickKernel<double, 1>(sections, num_sections, state, stride, in, out, 0, channels);
+}
+
+void scalarBlock(const Biquad* sections, size_t num_sections, double* state,
+	size_t stride, const double* in, double* out, size_t channels, size_t frames) {
+	blockKernel<double, 1>(sections, num_sections, state, stride, in, out, 0, channels, frames);
+}
+
+template<size_t N>
+void scalarTickSections(const Biquad* sections, size_t /*num_sections*/, double* state,
+	size_t stride, const double* in, double* out, size_t channels) {
+	tickSections<double, 1, N>(sections, state, stride, in, out, 0, channels);
+}
+
+#ifdef SOS_BANK_X86
+__attribute__((target("avx2")))
+void avx2Tick(const Biquad* sections, size_t num_sections, double* state,
+	size_t stride, const double* in, double* out, size_t channels) {
+	size_t done = tickKernel<Lanes4, 4>(sections, num_sections, state, stride, in, out, 0, channels);
+	tickKernel<double, 1>(sections, num_sections, state, stride, in, out, done, channels);
+}
+
+template<size_t N>
+__attribute__((target("avx2")))
+void avx2TickSections(const Biquad* sections, size_t /*num_sections*/, double* state,
+	size_t stride, const double* in, double* out, size_t channels) {
+	size_t done = tickSections<Lanes4, 4, N>(sections, state, stride, in, out, 0, channels);
+	tickSections<double, 1, N>(sections, state, stride, in, out, done, channels);
+}
+
+__attribute__((target("avx2")))
+void avx2Block(const Biquad* sections, size_t num_sections, double* state,
+	size_t stride, const double* in, double* out, size_t channels, size_t frames) {
+	size_t done = blockKernel<Lanes4, 4>(sections, num_sections, state, stride, in, out, 0, channels, frames);
+	blockKernel<double, 1>(sections, num_sections, state, stride, in, out, done, channels, frames);
+}
+
+__attribute__((target("avx512f")))
+void avx512Tick(const Biquad* sections, size_t num_sections, double* state,
+	size_t stride, const double* in, double* out, size_t channels) {
+	size_t done = tickKernel<Lanes8, 8>(sections, num_sections, state, stride, in, out, 0, channels);
+	done = tickKernel<Lanes4, 4>(sections, num_sections, state, stride, in, out, done, channels);
+	tickKernel<double, 1>(sections, num_sections, state, stride, in, out, done, channels);
+}
+
+template<size_t N>
+__attribute__((target("avx512f")))
+void avx512TickSections(const Biquad* sections, size_t /*num_sections*/, double* state,
+	size_t stride, const double* in, double* out, size_t channels) {
+	size_t done = tickSections<Lanes8, 8, N>(sections, state, stride, in, out, 0, channels);
+	done = tickSections<Lanes4, 4, N>(sections, state, stride, in, out, done, channels);
+	tickSections<double, 1, N>(sections, state, stride, in, out, done, channels);
+}
+
+__attribute__((target("avx512f")))
+void avx512Block(const Biquad* sections, size_t num_sections, double* state,
+	size_t stride, const double* in, double* out, size_t channels, size_t frames) {
+	size_t done = blockKernel<Lanes8, 8>(sections, num_sections, state, stride, in, out, 0, channels, frames);
+	done = blockKernel<Lanes4, 4>(sections, num_sections, state, stride, in, out, done, channels, frames);
+	blockKernel<double, 1>(sections, num_sections, state, stride, in, out, done, channels, frames);
+}
+#endif
+
+using TickTable = std::array<SosBank::Kernel, MAX_SPECIALIZED_SECTIONS + 1>;
+
+// entry n runs exactly n sections
+template<template<size_t> class Instance, size_t... N>
+constexpr TickTable tickTable(std::index_sequence<N...>) {
+	return {{Instance<N>::run...}};
+}
+
+template<size_t N> struct ScalarTick { static constexpr SosBank::Kernel run = scalarTickSections<N>; };
+#ifdef SOS_BANK_X86
+template<size_t N> struct Avx2Tick { static constexpr SosBank::Kernel run = avx2TickSections<N>; };
+template<size_t N> struct Avx512Tick { static constexpr SosBank::Kernel run = avx512TickSections<N>; };
+#endif
+
+struct KernelChoice {
+	SosBank::Kernel tick; // any number of sections
+	SosBank::BlockKernel block;
+	TickTable tick_sections;
+	const char* name;
+};
+
+const KernelChoice& bestKernel() {
+	using Counts = std::make_index_sequence<MAX_SPECIALIZED_SECTIONS + 1>;
+	static const KernelChoice choice = [] {
+#ifdef SOS_BANK_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f")) {
+			return KernelChoice{avx512Tick, avx512Block, tickTable<Avx512Tick>(Counts{}), "avx512"};
+		}
+		if (__builtin_cpu_supports("avx2")) {
+			return KernelChoice{avx2Tick, avx2Block, tickTable<Avx2Tick>(Counts{}), "avx2"};
+		}
+#endif
+		return KernelChoice{scalarTick, scalarBlock, tickTable<ScalarTick>(Counts{}), "scalar"};
+	}();
+	return choice;
+}
+
+// the unrolled kernel for this many sections if there is one
+SosBank::Kernel tickKernelFor(size_t num_sections) {
+	const KernelChoice& choice = bestKernel();
+	return num_sections <= MAX_SPECIALIZED_SECTIONS ? choice.tick_sections[num_sections] : choice.tick;
+}
+
+} // namespace
+
+SosBank::SosBank(const std::vector<Biquad>& biquads, size_t channels)
+	: sections(CoefficientPool::instance().intern(biquads)), num_channels(channels), kernel(tickKernelFor(biquads.size())),
+	block_kernel(bestKernel().block)
+{
+	stride = (channels + MAX_LANES - 1) / MAX_LANES * MAX_LANES;
+	const size_t bytes = std::max<size_t>(2 * sections.size() * stride * sizeof(double), ALIGNMENT);
+	state.reset(static_cast<double*>(std::aligned_alloc(ALIGNMENT, (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT)));
+	reset();
+}
+
+void SosBank::reset() {
+	if (state == nullptr) { return; }
+	std::memset(state.get(), 0, 2 * sections.size() * stride * sizeof(double));
+}
+
+void SosBank::setSteadyState(const double* input) {
+	if (state == nullptr) { return; }
+	for (size_t ch = 0; ch < num_channels; ++ch) {
+		double x = input[ch];
+		double* z = state.get() + ch;
+		for (size_t s = 0; s < sections.size(); ++s, z += 2 * stride) {
+			const Biquad& c = sections[s];
+			const double denom = 1 + c.a1 + c.a2;
+			if (denom == 0) {
+				z[0] = 0;
+				z[stride] = 0;
+				continue;
+			}
+			const double y = (c.b0 + c.b1 + c.b2) / denom * x;
+			z[stride] = c.b2 * x - c.a2 * y;
+			z[0] = c.b1 * x - c.a1 * y + z[stride];
+			x = y;
+		}
+	}
+}
+
+void SosBank::getState(double* out) const {
+	if (state == nullptr) { return; }
+	for (size_t row = 0; row < 2 * sections.size(); ++row) {
+		std::memcpy(out + row * num_channels, state.get() + row * stride, num_channels * sizeof(double));
+	}
+}
+
+void SosBank::setState(const double* in) {
+	if (state == nullptr) { return; }
+	for (size_t row = 0; row < 2 * sections.size(); ++row) {
+		std::memcpy(state.get() + row * stride, in + row * num_channels, num_channels * sizeof(double));
+	}
+}
+
+const char* SosBank::kernelName() {
+	return bestKernel().name;
+}
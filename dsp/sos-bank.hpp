@@ -0,0 +1,90 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* SosBank
+* Runs one cascade of second-order sections over many channels at once.
+* State is kept structure-of-arrays (all channels' z1 for a section, then all
+* channels' z2) so that one vector instruction advances 4 (AVX2) or 8
+* (AVX-512) channels. The kernel is picked once at construction from what the
+* CPU supports and, for up to 10 sections (order 20), from a table of
+* per-tick kernels unrolled for exactly that many sections. Every kernel
+* evaluates the same operations, in the same order, as SosCascade, so results
+* are identical whichever one runs. The sections are interned in the
+* CoefficientPool: banks built from the same sections share them, and each
+* bank owns only its state.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "coefficient-pool.hpp"
+#include "sos.hpp"
+
+class SosBank {
+	public:
+		SosBank() = default;
+		SosBank(const std::vector<Biquad>& biquads, size_t channels);
+
+		// one sample per channel, in[channel] -> out[channel]
+		void process(const double* in, double* out) {
+			kernel(sections.data(), sections.size(), state.get(), stride, in, out, num_channels);
+		}
+
+		// frames ticks at once, each frame holding one sample per channel;
+		// in and out may be the same buffer
+		void process(const double* in, double* out, size_t frames) {
+			block_kernel(sections.data(), sections.size(), state.get(), stride, in, out, num_channels, frames);
+		}
+		void processInPlace(double* data, size_t frames) { process(data, data, frames); }
+
+		void reset();
+		// each channel's state as if input[channel] had been applied forever
+		void setSteadyState(const double* input);
+		// the state packed as [section][z1|z2][channel], 2 * numSections() *
+		// numChannels() values; no allocation, so the real-time thread can
+		// take a snapshot
+		void getState(double* out) const;
+		void setState(const double* in);
+
+		size_t numChannels() const { return num_channels; }
+		size_t numSections() const { return sections.size(); }
+		const SharedCoefficients<Biquad>& getSections() const { return sections; }
+
+		using Kernel = void (*)(const Biquad* sections, size_t num_sections,
+			double* state, size_t stride, const double* in, double* out, size_t channels);
+		using BlockKernel = void (*)(const Biquad* sections, size_t num_sections,
+			double* state, size_t stride, const double* in, double* out, size_t channels,
+			size_t frames);
+
+		// name of the kernel chosen for this CPU, for logging
+		static const char* kernelName();
+
+	private:
+		struct Free { void operator()(double* p) const { std::free(p); } };
+
+		SharedCoefficients<Biquad> sections; // read-only, shared
+		std::unique_ptr<double[], Free> state; // [section][z1|z2][channel]
+		size_t num_channels = 0;
+		size_t stride = 0; // channels rounded up to the widest vector
+		Kernel kernel = nullptr;
+		BlockKernel block_kernel = nullptr;
+};
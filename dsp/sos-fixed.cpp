@@ -0,0 +1,381 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "sos-fixed.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SOS_FIXED_X86 1
+#endif
+
+namespace {
+
+constexpr size_t ALIGNMENT = 64;
+constexpr size_t MAX_LANES = 8; // int64 lanes per AVX-512 register
+constexpr size_t BLOCK_FRAMES = 64; // frames converted to fixed point at a time
+// 1.5 * 2^52: adding it to anything under 2^51 in magnitude rounds to an
+// integer held in the low bits of the mantissa
+constexpr double ROUND = 6755399441055744.0;
+constexpr int64_t ROUND_BITS = 0x4338000000000000;
+
+typedef double Lanes4 __attribute__((vector_size(4 * sizeof(double))));
+typedef double Lanes8 __attribute__((vector_size(8 * sizeof(double))));
+typedef int64_t Ints4 __attribute__((vector_size(4 * sizeof(int64_t))));
+typedef int64_t Ints8 __attribute__((vector_size(8 * sizeof(int64_t))));
+
+// integer sections over frames rows of stride samples, in place
+using SectionsFn = void (*)(const FixedBiquad* sections, size_t num_sections,
+	int64_t* state, size_t stride, int64_t* samples, size_t frames, int right_shift,
+	int64_t lo, int64_t hi);
+
+int64_t* allocate(size_t count) {
+	const size_t bytes = std::max<size_t>(count * sizeof(int64_t), ALIGNMENT);
+	auto* p = static_cast<int64_t*>(std::aligned_alloc(ALIGNMENT, (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT));
+	std::memset(p, 0, bytes);
+	return p;
+}
+
+// Direct form I. The accumulator wraps like the hardware's rather than
+// invoking signed overflow; products of two 32-bit values cannot overflow.
+void scalarSections(const FixedBiquad* sections, size_t num_sections, int64_t* state,
+	size_t stride, int64_t* samples, size_t frames, int right_shift, int64_t lo, int64_t hi) {
+	for (size_t f = 0; f < frames; ++f) {
+		int64_t* row = samples + f * stride;
+		for (size_t ch = 0; ch < stride; ++ch) {
+			int64_t x = row[ch];
+			int64_t* z = state + ch;
+			for (size_t s = 0; s < num_sections; ++s, z += 4 * stride) {
+				const FixedBiquad& c = sections[s];
+				const int64_t x1 = z[0];
+				const int64_t x2 = z[stride];
+				const int64_t y1 = z[2 * stride];
+				const int64_t y2 = z[3 * stride];
+				const uint64_t acc = static_cast<uint64_t>(c.b0 * x) + static_cast<uint64_t>(c.b1 * x1)
+					+ static_cast<uint64_t>(c.b2 * x2) - static_cast<uint64_t>(c.a1 * y1)
+					- static_cast<uint64_t>(c.a2 * y2);
+				const int64_t y = std::min(hi, std::max(lo, static_cast<int64_t>(acc) >> right_shift));
+				z[stride] = x1;
+				z[0] = x;
+				z[3 * stride] = y1;
+				z[2 * stride] = y;
+				x = y;
+			}
+			row[ch] = x;
+		}
+	}
+}
+
+#ifdef SOS_FIXED_X86
+// Values sit sign-extended in 64-bit lanes, so mul_epi32 gives the exact
+// 32 x 32 -> 64 bit product. As in SosBank, up to four sections at a time
+// keep their state in registers for the whole block so the CPU can overlap
+// successive frames; samples doubles as the buffer between groups.
+template<size_t K>
+__attribute__((target("avx2"))) inline void avx2Group(const FixedBiquad* sections,
+	int64_t* z, size_t stride, int64_t* samples, size_t frames, __m128i count,
+	__m256i vlo, __m256i vhi) {
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i x1[K], x2[K], y1[K], y2[K];
+	for (size_t k = 0; k < K; ++k) {
+		x1[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(z + 4 * k * stride));
+		x2[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(z + (4 * k + 1) * stride));
+		y1[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(z + (4 * k + 2) * stride));
+		y2[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(z + (4 * k + 3) * stride));
+	}
+	for (size_t f = 0; f < frames; ++f) {
+		__m256i* row = reinterpret_cast<__m256i*>(samples + f * stride);
+		__m256i x = _mm256_loadu_si256(row);
+#pragma GCC unroll 4
+		for (size_t k = 0; k < K; ++k) {
+			const FixedBiquad& c = sections[k];
+			__m256i acc = _mm256_add_epi64(_mm256_mul_epi32(_mm256_set1_epi64x(c.b0), x),
+				_mm256_mul_epi32(_mm256_set1_epi64x(c.b1), x1[k]));
+			acc = _mm256_add_epi64(acc, _mm256_mul_epi32(_mm256_set1_epi64x(c.b2), x2[k]));
+			acc = _mm256_sub_epi64(acc, _mm256_mul_epi32(_mm256_set1_epi64x(c.a1), y1[k]));
+			acc = _mm256_sub_epi64(acc, _mm256_mul_epi32(_mm256_set1_epi64x(c.a2), y2[k]));
+			// AVX2 has no 64-bit arithmetic shift: shift the one's complement
+			// of negative lanes logically and complement back
+			const __m256i sign = _mm256_cmpgt_epi64(zero, acc);
+			__m256i y = _mm256_xor_si256(_mm256_srl_epi64(_mm256_xor_si256(acc, sign), count), sign);
+			y = _mm256_blendv_epi8(y, vhi, _mm256_cmpgt_epi64(y, vhi));
+			y = _mm256_blendv_epi8(y, vlo, _mm256_cmpgt_epi64(vlo, y));
+			x2[k] = x1[k];
+			x1[k] = x;
+			y2[k] = y1[k];
+			y1[k] = y;
+			x = y;
+		}
+		_mm256_storeu_si256(row, x);
+	}
+	for (size_t k = 0; k < K; ++k) {
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(z + 4 * k * stride), x1[k]);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(z + (4 * k + 1) * stride), x2[k]);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(z + (4 * k + 2) * stride), y1[k]);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(z + (4 * k + 3) * stride), y2[k]);
+	}
+}
+
+__attribute__((target("avx2")))
+void avx2Sections(const FixedBiquad* sections, size_t num_sections, int64_t* state,
+	size_t stride, int64_t* samples, size_t frames, int right_shift, int64_t lo, int64_t hi) {
+	const __m256i vlo = _mm256_set1_epi64x(lo);
+	const __m256i vhi = _mm256_set1_epi64x(hi);
+	const __m128i count = _mm_cvtsi32_si128(right_shift);
+	for (size_t ch = 0; ch < stride; ch += 4) {
+		for (size_t s = 0; s < num_sections; s += 4) {
+			int64_t* z = state + 4 * s * stride + ch;
+			switch (std::min<size_t>(num_sections - s, 4)) {
+				case 1: avx2Group<1>(sections + s, z, stride, samples + ch, frames, count, vlo, vhi); break;
+				case 2: avx2Group<2>(sections + s, z, stride, samples + ch, frames, count, vlo, vhi); break;
+				case 3: avx2Group<3>(sections + s, z, stride, samples + ch, frames, count, vlo, vhi); break;
+				default: avx2Group<4>(sections + s, z, stride, samples + ch, frames, count, vlo, vhi); break;
+			}
+		}
+	}
+}
+
+template<size_t K>
+__attribute__((target("avx512f"))) inline void avx512Group(const FixedBiquad* sections,
+	int64_t* z, size_t stride, int64_t* samples, size_t frames, __m128i count,
+	__m512i vlo, __m512i vhi) {
+	__m512i x1[K], x2[K], y1[K], y2[K];
+	for (size_t k = 0; k < K; ++k) {
+		x1[k] = _mm512_loadu_si512(z + 4 * k * stride);
+		x2[k] = _mm512_loadu_si512(z + (4 * k + 1) * stride);
+		y1[k] = _mm512_loadu_si512(z + (4 * k + 2) * stride);
+		y2[k] = _mm512_loadu_si512(z + (4 * k + 3) * stride);
+	}
+	for (size_t f = 0; f < frames; ++f) {
+		int64_t* row = samples + f * stride;
+		__m512i x = _mm512_loadu_si512(row);
+#pragma GCC unroll 4
+		for (size_t k = 0; k < K; ++k) {
+			const FixedBiquad& c = sections[k];
+			__m512i acc = _mm512_add_epi64(_mm512_mul_epi32(_mm512_set1_epi64(c.b0), x),
+				_mm512_mul_epi32(_mm512_set1_epi64(c.b1), x1[k]));
+			acc = _mm512_add_epi64(acc, _mm512_mul_epi32(_mm512_set1_epi64(c.b2), x2[k]));
+			acc = _mm512_sub_epi64(acc, _mm512_mul_epi32(_mm512_set1_epi64(c.a1), y1[k]));
+			acc = _mm512_sub_epi64(acc, _mm512_mul_epi32(_mm512_set1_epi64(c.a2), y2[k]));
+			const __m512i y = _mm512_min_epi64(vhi, _mm512_max_epi64(vlo, _mm512_sra_epi64(acc, count)));
+			x2[k] = x1[k];
+			x1[k] = x;
+			y2[k] = y1[k];
+			y1[k] = y;
+			x = y;
+		}
+		_mm512_storeu_si512(row, x);
+	}
+	for (size_t k = 0; k < K; ++k) {
+		_mm512_storeu_si512(z + 4 * k * stride, x1[k]);
+		_mm512_storeu_si512(z + (4 * k + 1) * stride, x2[k]);
+		_mm512_storeu_si512(z + (4 * k + 2) * stride, y1[k]);
+		_mm512_storeu_si512(z + (4 * k + 3) * stride, y2[k]);
+	}
+}
+
+__attribute__((target("avx512f")))
+void avx512Sections(const FixedBiquad* sections, size_t num_sections, int64_t* state,
+	size_t stride, int64_t* samples, size_t frames, int right_shift, int64_t lo, int64_t hi) {
+	const __m512i vlo = _mm512_set1_epi64(lo);
+	const __m512i vhi = _mm512_set1_epi64(hi);
+	const __m128i count = _mm_cvtsi32_si128(right_shift);
+	for (size_t ch = 0; ch < stride; ch += 8) {
+		for (size_t s = 0; s < num_sections; s += 4) {
+			int64_t* z = state + 4 * s * stride + ch;
+			switch (std::min<size_t>(num_sections - s, 4)) {
+				case 1: avx512Group<1>(sections + s, z, stride, samples + ch, frames, count, vlo, vhi); break;
+				case 2: avx512Group<2>(sections + s, z, stride, samples + ch, frames, count, vlo, vhi); break;
+				case 3: avx512Group<3>(sections + s, z, stride, samples + ch, frames, count, vlo, vhi); break;
+				default: avx512Group<4>(sections + s, z, stride, samples + ch, frames, count, vlo, vhi); break;
+			}
+		}
+	}
+}
+#endif
+
+// One frame's channels from double to fixed point, LANES at a time from
+// first; returns where it stopped. V is double or a GCC vector of doubles and
+// I the matching integers. Saturates first (NaN fails every comparison and
+// becomes zero), then rounds to nearest even by adding ROUND, which leaves
+// the integer in the low mantissa bits.
+template<typename V, typename I, size_t LANES>
+inline __attribute__((always_inline)) size_t toFixedRow(const double* src, int64_t* dst,
+	size_t first, size_t channels, const FixedSosBank::Scaling& scaling) {
+	const V scale = V{} + scaling.to_fixed;
+	const V lo = V{} + static_cast<double>(scaling.lo);
+	const V hi = V{} + static_cast<double>(scaling.hi);
+	const V zero = V{};
+	size_t ch = first;
+	for (; ch + LANES <= channels; ch += LANES) {
+		V value;
+		std::memcpy(&value, src + ch, sizeof(V));
+		value = value * scale;
+		value = value > hi ? hi : value;
+		value = value < lo ? lo : value;
+		value = value == value ? value : zero;
+		value = value + ROUND;
+		I bits;
+		std::memcpy(&bits, &value, sizeof(I));
+		bits = bits - ROUND_BITS;
+		std::memcpy(dst + ch, &bits, sizeof(I));
+	}
+	return ch;
+}
+
+// and back: the integer plus ROUND_BITS is exactly ROUND + the integer
+template<typename V, typename I, size_t LANES>
+inline __attribute__((always_inline)) size_t toDoubleRow(const int64_t* src, double* dst,
+	size_t first, size_t channels, const FixedSosBank::Scaling& scaling) {
+	size_t ch = first;
+	for (; ch + LANES <= channels; ch += LANES) {
+		I bits;
+		std::memcpy(&bits, src + ch, sizeof(I));
+		bits = bits + ROUND_BITS;
+		V value;
+		std::memcpy(&value, &bits, sizeof(V));
+		value = (value - ROUND) * scaling.to_double;
+		std::memcpy(dst + ch, &value, sizeof(V));
+	}
+	return ch;
+}
+
+template<typename V, typename I, size_t LANES, SectionsFn RUN>
+inline __attribute__((always_inline)) void runBlocks(const FixedBiquad* sections,
+	size_t num_sections, int64_t* state, size_t stride, int64_t* scratch,
+	const FixedSosBank::Scaling& scaling, const double* in, double* out,
+	size_t channels, size_t frames) {
+	for (size_t done = 0; done < frames; done += BLOCK_FRAMES) {
+		const size_t n = std::min(BLOCK_FRAMES, frames - done);
+		for (size_t f = 0; f < n; ++f) {
+			const double* src = in + (done + f) * channels;
+			const size_t ch = toFixedRow<V, I, LANES>(src, scratch + f * stride, 0, channels, scaling);
+			toFixedRow<double, int64_t, 1>(src, scratch + f * stride, ch, channels, scaling);
+		}
+		RUN(sections, num_sections, state, stride, scratch, n, scaling.right_shift, scaling.lo, scaling.hi);
+		for (size_t f = 0; f < n; ++f) {
+			double* dst = out + (done + f) * channels;
+			const size_t ch = toDoubleRow<V, I, LANES>(scratch + f * stride, dst, 0, channels, scaling);
+			toDoubleRow<double, int64_t, 1>(scratch + f * stride, dst, ch, channels, scaling);
+		}
+	}
+}
+
+void scalarKernel(const FixedBiquad* sections, size_t num_sections, int64_t* state,
+	size_t stride, int64_t* scratch, const FixedSosBank::Scaling& scaling,
+	const double* in, double* out, size_t channels, size_t frames) {
+	runBlocks<double, int64_t, 1, scalarSections>(sections, num_sections, state, stride,
+		scratch, scaling, in, out, channels, frames);
+}
+
+#ifdef SOS_FIXED_X86
+__attribute__((target("avx2")))
+void avx2Kernel(const FixedBiquad* sections, size_t num_sections, int64_t* state,
+	size_t stride, int64_t* scratch, const FixedSosBank::Scaling& scaling,
+	const double* in, double* out, size_t channels, size_t frames) {
+	runBlocks<Lanes4, Ints4, 4, avx2Sections>(sections, num_sections, state, stride,
+		scratch, scaling, in, out, channels, frames);
+}
+
+__attribute__((target("avx512f")))
+void avx512Kernel(const FixedBiquad* sections, size_t num_sections, int64_t* state,
+	size_t stride, int64_t* scratch, const FixedSosBank::Scaling& scaling,
+	const double* in, double* out, size_t channels, size_t frames) {
+	runBlocks<Lanes8, Ints8, 8, avx512Sections>(sections, num_sections, state, stride,
+		scratch, scaling, in, out, channels, frames);
+}
+#endif
+
+struct KernelChoice {
+	FixedSosBank::Kernel kernel;
+	const char* name;
+};
+
+const KernelChoice& bestKernel() {
+	static const KernelChoice choice = [] {
+#ifdef SOS_FIXED_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f")) { return KernelChoice{avx512Kernel, "avx512"}; }
+		if (__builtin_cpu_supports("avx2")) { return KernelChoice{avx2Kernel, "avx2"}; }
+#endif
+		return KernelChoice{scalarKernel, "scalar"};
+	}();
+	return choice;
+}
+
+// Smallest post-shift for which every coefficient, scaled to
+// Q(frac_bits - shift), fits the sample range.
+int postShiftFor(const std::vector<Biquad>& biquads, int frac_bits, int64_t lo, int64_t hi) {
+	for (int shift = 0; shift < frac_bits; shift++) {
+		bool fits = true;
+		for (const Biquad& c : biquads) {
+			for (double value : {c.b0, c.b1, c.b2, c.a1, c.a2}) {
+				const double q = std::nearbyint(std::ldexp(value, frac_bits - shift));
+				fits = fits && q >= lo && q <= hi;
+			}
+		}
+		if (fits) { return shift; }
+	}
+	return frac_bits;
+}
+
+} // namespace
+
+FixedSosBank::FixedSosBank(const std::vector<Biquad>& biquads, size_t channels, int frac_bits, double full_scale)
+	: num_channels(channels), frac_bits(frac_bits), kernel(bestKernel().kernel)
+{
+	const int64_t lo = -(int64_t{1} << frac_bits);
+	const int64_t hi = (int64_t{1} << frac_bits) - 1;
+	shift = postShiftFor(biquads, frac_bits, lo, hi);
+	const int coeff_bits = frac_bits - shift;
+	auto quantize = [lo, hi, coeff_bits](double value) {
+		return std::min(hi, std::max(lo, static_cast<int64_t>(std::nearbyint(std::ldexp(value, coeff_bits)))));
+	};
+	std::vector<FixedBiquad> quantized;
+	for (const Biquad& c : biquads) {
+		quantized.push_back({quantize(c.b0), quantize(c.b1), quantize(c.b2), quantize(c.a1), quantize(c.a2)});
+	}
+	sections = CoefficientPool::instance().intern(quantized);
+	if (!(full_scale > 0)) { full_scale = 1; }
+	scaling.to_fixed = std::ldexp(1.0, frac_bits) / full_scale;
+	scaling.to_double = full_scale / std::ldexp(1.0, frac_bits);
+	scaling.lo = lo;
+	scaling.hi = hi;
+	scaling.right_shift = coeff_bits;
+
+	// padding lanes are filtered too; they stay at zero
+	stride = (channels + MAX_LANES - 1) / MAX_LANES * MAX_LANES;
+	state.reset(allocate(4 * sections.size() * stride));
+	scratch.reset(allocate(BLOCK_FRAMES * stride));
+}
+
+void FixedSosBank::process(const double* in, double* out, size_t frames) {
+	kernel(sections.data(), sections.size(), state.get(), stride, scratch.get(), scaling,
+		in, out, num_channels, frames);
+}
+
+void FixedSosBank::reset() {
+	if (state == nullptr) { return; }
+	std::memset(state.get(), 0, 4 * sections.size() * stride * sizeof(int64_t));
+}
+
+const char* FixedSosBank::kernelName() {
+	return bestKernel().name;
+}
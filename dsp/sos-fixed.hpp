@@ -0,0 +1,101 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* FixedSosBank
+* Second-order sections in integer fixed point, as an embedded target runs
+* them: Q15 (16-bit samples and coefficients) or Q31 (32-bit), direct form I,
+* a 64-bit accumulator, one post-shift for the whole cascade so coefficients
+* up to 2^shift in magnitude fit (the scheme of CMSIS-DSP's
+* arm_biquad_cascade_df1_q15/q31), and saturation of every section's output.
+*
+* Samples come in and go out as doubles: an input of full_scale maps to the
+* largest fixed-point value. Like SosBank, many channels run side by side in
+* vector registers (4 with AVX2, 8 with AVX-512); the arithmetic is all
+* integer, so every kernel gives the same result. The quantized sections
+* are interned in the CoefficientPool, like SosBank's.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "coefficient-pool.hpp"
+#include "sos.hpp"
+
+// Coefficients quantized to Q(frac_bits - shift). Every value fits in 32 bits;
+// they are held in 64-bit lanes for the multiply.
+struct FixedBiquad {
+	int64_t b0, b1, b2;
+	int64_t a1, a2;
+};
+
+class FixedSosBank {
+	public:
+		FixedSosBank() = default;
+		FixedSosBank(const std::vector<Biquad>& biquads, size_t channels, int frac_bits, double full_scale);
+
+		// one sample per channel, in[channel] -> out[channel]
+		void process(const double* in, double* out) { process(in, out, 1); }
+
+		// frames ticks at once, each frame holding one sample per channel;
+		// in and out may be the same buffer
+		void process(const double* in, double* out, size_t frames);
+
+		void reset();
+
+		size_t numChannels() const { return num_channels; }
+		size_t numSections() const { return sections.size(); }
+		int fracBits() const { return frac_bits; }
+		int postShift() const { return shift; }
+		const SharedCoefficients<FixedBiquad>& getSections() const { return sections; }
+
+		// conversion between doubles and fixed point
+		struct Scaling {
+			double to_fixed; // 2^frac_bits / full_scale
+			double to_double;
+			int64_t lo; // saturation limits
+			int64_t hi;
+			int right_shift; // accumulator to sample: frac_bits - post-shift
+		};
+
+		// converts frames of in through scratch (BLOCK_FRAMES rows of stride
+		// samples), runs the sections and converts back to out
+		using Kernel = void (*)(const FixedBiquad* sections, size_t num_sections,
+			int64_t* state, size_t stride, int64_t* scratch, const Scaling& scaling,
+			const double* in, double* out, size_t channels, size_t frames);
+
+		// name of the kernel chosen for this CPU, for logging
+		static const char* kernelName();
+
+	private:
+		struct Free { void operator()(int64_t* p) const { std::free(p); } };
+
+		SharedCoefficients<FixedBiquad> sections; // read-only, shared
+		std::unique_ptr<int64_t[], Free> state; // [section][x1|x2|y1|y2][channel]
+		std::unique_ptr<int64_t[], Free> scratch;
+		size_t num_channels = 0;
+		size_t stride = 0; // channels rounded up to the widest vector
+		int frac_bits = 15;
+		int shift = 0;
+		Scaling scaling{};
+		Kernel kernel = nullptr;
+};
@@ -0,0 +1,297 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include "coefficient-pool.hpp"
+#include "sos-precision.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SOS_PRECISION_X86 1
+#endif
+
+namespace {
+
+constexpr size_t ALIGNMENT = 64; // one cache line, one AVX-512 register
+constexpr size_t MAX_LANES = 16; // floats per AVX-512 register
+
+// a relative rounding of a float
+constexpr double FLOAT_EPSILON = std::numeric_limits<float>::epsilon() / 2;
+// Near z = 1 the gain goes as 1 / (distance from the unit circle), so a pole
+// moved by a fraction of that distance changes the response by about the
+// same fraction. Both that and the float state noise are held to -80 dB of
+// the signal.
+constexpr double TOLERANCE = 1e-4;
+
+typedef float Floats2 __attribute__((vector_size(2 * sizeof(float))));
+typedef float Floats4 __attribute__((vector_size(4 * sizeof(float))));
+typedef float Floats8 __attribute__((vector_size(8 * sizeof(float))));
+typedef float Floats16 __attribute__((vector_size(16 * sizeof(float))));
+typedef double Doubles2 __attribute__((vector_size(2 * sizeof(double))));
+typedef double Doubles4 __attribute__((vector_size(4 * sizeof(double))));
+typedef double Doubles8 __attribute__((vector_size(8 * sizeof(double))));
+typedef double Doubles16 __attribute__((vector_size(16 * sizeof(double))));
+
+template<typename T>
+struct Coefficients {
+	T b0, b1, b2;
+	T a1, a2;
+};
+
+// element-wise conversion between scalars or between vectors of equal length
+template<typename To, typename From>
+inline __attribute__((always_inline)) void convert(const From& from, To& to) {
+	if constexpr (std::is_arithmetic_v<From>) {
+		to = static_cast<To>(from);
+	} else {
+		to = __builtin_convertvector(from, To);
+	}
+}
+
+// One tick for LANES channels: S holds LANES state values, A LANES values of
+// the accumulator type and D LANES doubles. The same operations in the same
+// order as SosCascade, only in other types.
+template<typename State, typename Accum, typename S, typename A, typename D, size_t LANES>
+inline __attribute__((always_inline)) size_t tickKernel(const Coefficients<Accum>* sections,
+	size_t num_sections, State* state, size_t stride, const double* in, double* out,
+	size_t first, size_t channels) {
+	size_t ch = first;
+	for (; ch + LANES <= channels; ch += LANES) {
+		D sample;
+		std::memcpy(&sample, in + ch, sizeof(D));
+		A x;
+		convert(sample, x);
+		State* z = state + ch;
+		for (size_t s = 0; s < num_sections; ++s, z += 2 * stride) {
+			const Coefficients<Accum>& c = sections[s];
+			S stored1, stored2;
+			std::memcpy(&stored1, z, sizeof(S));
+			std::memcpy(&stored2, z + stride, sizeof(S));
+			A z1, z2;
+			convert(stored1, z1);
+			convert(stored2, z2);
+			const A y = c.b0 * x + z1;
+			convert(c.b1 * x - c.a1 * y + z2, stored1);
+			convert(c.b2 * x - c.a2 * y, stored2);
+			std::memcpy(z, &stored1, sizeof(S));
+			std::memcpy(z + stride, &stored2, sizeof(S));
+			x = y;
+		}
+		convert(x, sample);
+		std::memcpy(out + ch, &sample, sizeof(D));
+	}
+	return ch;
+}
+
+template<typename State, typename Accum>
+using Kernel = void (*)(const Coefficients<Accum>* sections, size_t num_sections, State* state,
+	size_t stride, const double* in, double* out, size_t channels, size_t frames);
+
+// The vector types for each width: single precision fills a register with
+// floats, mixed precision with the doubles it computes in. Half is for the
+// channels left over after the widest vectors, as SosBank runs them.
+template<typename State, typename Accum> struct Vectors;
+
+template<>
+struct Vectors<float, float> {
+	using Half = Floats4; using HalfAccum = Floats4; using HalfDoubles = Doubles4;
+	using Narrow = Floats8; using NarrowAccum = Floats8; using NarrowDoubles = Doubles8;
+	using Wide = Floats16; using WideAccum = Floats16; using WideDoubles = Doubles16;
+	static constexpr size_t HALF = 4;
+	static constexpr size_t NARROW = 8; // AVX2
+	static constexpr size_t WIDE = 16; // AVX-512
+};
+
+template<>
+struct Vectors<float, double> {
+	using Half = Floats2; using HalfAccum = Doubles2; using HalfDoubles = Doubles2;
+	using Narrow = Floats4; using NarrowAccum = Doubles4; using NarrowDoubles = Doubles4;
+	using Wide = Floats8; using WideAccum = Doubles8; using WideDoubles = Doubles8;
+	static constexpr size_t HALF = 2;
+	static constexpr size_t NARROW = 4;
+	static constexpr size_t WIDE = 8;
+};
+
+// frames ticks; each frame is finished for every channel before the next
+// starts, so in and out may be the same buffer
+template<typename State, typename Accum>
+void scalarKernel(const Coefficients<Accum>* sections, size_t num_sections, State* state,
+	size_t stride, const double* in, double* out, size_t channels, size_t frames) {
+	for (size_t f = 0; f < frames; ++f) {
+		tickKernel<State, Accum, State, Accum, double, 1>(sections, num_sections, state, stride,
+			in + f * channels, out + f * channels, 0, channels);
+	}
+}
+
+#ifdef SOS_PRECISION_X86
+template<typename State, typename Accum>
+__attribute__((target("avx2")))
+void avx2Kernel(const Coefficients<Accum>* sections, size_t num_sections, State* state,
+	size_t stride, const double* in, double* out, size_t channels, size_t frames) {
+	using V = Vectors<State, Accum>;
+	for (size_t f = 0; f < frames; ++f) {
+		const double* src = in + f * channels;
+		double* dst = out + f * channels;
+		size_t done = tickKernel<State, Accum, typename V::Narrow, typename V::NarrowAccum,
+			typename V::NarrowDoubles, V::NARROW>(sections, num_sections, state, stride, src, dst, 0, channels);
+		done = tickKernel<State, Accum, typename V::Half, typename V::HalfAccum,
+			typename V::HalfDoubles, V::HALF>(sections, num_sections, state, stride, src, dst, done, channels);
+		tickKernel<State, Accum, State, Accum, double, 1>(sections, num_sections, state, stride,
+			src, dst, done, channels);
+	}
+}
+
+template<typename State, typename Accum>
+__attribute__((target("avx512f")))
+void avx512Kernel(const Coefficients<Accum>* sections, size_t num_sections, State* state,
+	size_t stride, const double* in, double* out, size_t channels, size_t frames) {
+	using V = Vectors<State, Accum>;
+	for (size_t f = 0; f < frames; ++f) {
+		const double* src = in + f * channels;
+		double* dst = out + f * channels;
+		size_t done = tickKernel<State, Accum, typename V::Wide, typename V::WideAccum,
+			typename V::WideDoubles, V::WIDE>(sections, num_sections, state, stride, src, dst, 0, channels);
+		done = tickKernel<State, Accum, typename V::Narrow, typename V::NarrowAccum,
+			typename V::NarrowDoubles, V::NARROW>(sections, num_sections, state, stride, src, dst, done, channels);
+		done = tickKernel<State, Accum, typename V::Half, typename V::HalfAccum,
+			typename V::HalfDoubles, V::HALF>(sections, num_sections, state, stride, src, dst, done, channels);
+		tickKernel<State, Accum, State, Accum, double, 1>(sections, num_sections, state, stride,
+			src, dst, done, channels);
+	}
+}
+#endif
+
+template<typename State, typename Accum>
+Kernel<State, Accum> bestKernel(const char*& name) {
+#ifdef SOS_PRECISION_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		name = "avx512";
+		return avx512Kernel<State, Accum>;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		name = "avx2";
+		return avx2Kernel<State, Accum>;
+	}
+#endif
+	name = "scalar";
+	return scalarKernel<State, Accum>;
+}
+
+template<typename State, typename Accum>
+class PrecisionSosBank : public TopologyBank {
+	public:
+		PrecisionSosBank(const std::vector<Biquad>& biquads, size_t channels)
+			: num_channels(channels), stride((channels + MAX_LANES - 1) / MAX_LANES * MAX_LANES),
+			rows(2 * biquads.size())
+		{
+			std::vector<Coefficients<Accum>> rounded;
+			for (const Biquad& c : biquads) {
+				rounded.push_back({static_cast<Accum>(c.b0), static_cast<Accum>(c.b1),
+					static_cast<Accum>(c.b2), static_cast<Accum>(c.a1), static_cast<Accum>(c.a2)});
+			}
+			sections = CoefficientPool::instance().intern(rounded);
+			kernel = bestKernel<State, Accum>(kernel_name);
+			const size_t bytes = std::max<size_t>(rows * stride * sizeof(State), ALIGNMENT);
+			state.reset(static_cast<State*>(std::aligned_alloc(ALIGNMENT, (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT)));
+			reset();
+		}
+
+		void process(const double* in, double* out) override {
+			kernel(sections.data(), sections.size(), state.get(), stride, in, out, num_channels, 1);
+		}
+		void process(const double* in, double* out, size_t frames) override {
+			kernel(sections.data(), sections.size(), state.get(), stride, in, out, num_channels, frames);
+		}
+		void reset() override {
+			std::memset(state.get(), 0, rows * stride * sizeof(State));
+		}
+		// worked out in double from the coefficients as run, then stored
+		void setSteadyState(const double* input) override {
+			for (size_t ch = 0; ch < num_channels; ++ch) {
+				double x = input[ch];
+				State* z = state.get() + ch;
+				for (size_t s = 0; s < sections.size(); ++s, z += 2 * stride) {
+					const Coefficients<Accum>& c = sections[s];
+					const double denom = 1.0 + c.a1 + c.a2;
+					if (denom == 0) {
+						z[0] = 0;
+						z[stride] = 0;
+						continue;
+					}
+					const double y = (static_cast<double>(c.b0) + c.b1 + c.b2) / denom * x;
+					const double z2 = c.b2 * x - c.a2 * y;
+					z[0] = static_cast<State>(c.b1 * x - c.a1 * y + z2);
+					z[stride] = static_cast<State>(z2);
+					x = y;
+				}
+			}
+		}
+		size_t numChannels() const override { return num_channels; }
+		const char* kernelName() const override { return kernel_name; }
+
+	private:
+		struct Free { void operator()(State* p) const { std::free(p); } };
+
+		SharedCoefficients<Coefficients<Accum>> sections; // read-only, shared
+		size_t num_channels;
+		size_t stride; // channels rounded up to the widest vector
+		size_t rows; // state rows of stride values
+		std::unique_ptr<State[], Free> state;
+		Kernel<State, Accum> kernel = nullptr;
+		const char* kernel_name = "";
+};
+
+} // namespace
+
+// For z^2 + a1 z + a2 with roots p1, p2, a change da1, da2 moves p1 by
+// -(p1 da1 + da2) / (p1 - p2) to first order; float rounding makes
+// |da| <= FLOAT_EPSILON |a|. A rounding error left in the state decays as
+// |p|^n, so it adds up to at most FLOAT_EPSILON / (1 - |p|) of the signal.
+precision_t choosePrecision(const std::vector<Biquad>& sections) {
+	using cplx = std::complex<double>;
+	bool single = true;
+	for (const Biquad& c : sections) {
+		const cplx root = std::sqrt(cplx(c.a1 * c.a1 - 4 * c.a2));
+		const cplx poles[2] = {(-c.a1 + root) / 2.0, (-c.a1 - root) / 2.0};
+		const double separation = std::abs(poles[0] - poles[1]);
+		for (const cplx& p : poles) {
+			if (std::abs(p) == 0) { continue; }
+			const double margin = 1 - std::abs(p);
+			if (!(margin > 0)) { return DOUBLE_PRECISION; }
+			const double shift = FLOAT_EPSILON * (std::abs(c.a1) * std::abs(p) + std::abs(c.a2));
+			// repeated poles split by the square root of a rounding: never single
+			single = single && separation > 0 && shift <= TOLERANCE * margin * separation
+				&& FLOAT_EPSILON <= TOLERANCE * margin;
+		}
+	}
+	return single ? SINGLE_PRECISION : DOUBLE_PRECISION;
+}
+
+std::unique_ptr<TopologyBank> makeSinglePrecisionBank(const std::vector<Biquad>& biquads, size_t channels) {
+	return std::make_unique<PrecisionSosBank<float, float>>(biquads, channels);
+}
+
+std::unique_ptr<TopologyBank> makeMixedPrecisionBank(const std::vector<Biquad>& biquads, size_t channels) {
+	return std::make_unique<PrecisionSosBank<float, double>>(biquads, channels);
+}
@@ -0,0 +1,61 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* PrecisionSosBank
+* SosBank's transposed direct form II cascade templated on the type its state
+* is stored in and the type it multiplies and adds in:
+*
+*   single: float state and float coefficients; twice as many channels per
+*     vector register as double (8 with AVX2, 16 with AVX-512) and half the
+*     state memory, but every pole moves by a float rounding of a1 and a2,
+*     which for a cutoff far below the sample rate changes the response by
+*     far more than the rounding itself.
+*   mixed: float state, double coefficients and arithmetic; the poles are
+*     exactly the double design's and only the stored state is rounded,
+*     which adds noise at about -140 dB of the signal divided by each pole's
+*     distance from the unit circle. Half the state memory of double, for
+*     very many channels, but the conversions make each tick slower.
+*
+* Samples come in and go out as doubles either way. choosePrecision() picks
+* single where a design's poles tolerate it.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "sos.hpp"
+#include "topologies.hpp"
+
+enum precision_t : uint64_t {
+	DOUBLE_PRECISION=0, // SosBank: double state, coefficients and arithmetic
+	SINGLE_PRECISION, // float state, coefficients and arithmetic
+	MIXED_PRECISION, // float state, double coefficients and arithmetic
+	AUTO_PRECISION, // whichever choosePrecision() picks
+};
+
+// SINGLE_PRECISION if rounding the coefficients to float moves no pole by more
+// than 1e-4 of its distance from the unit circle and float state noise stays
+// below -80 dB, otherwise DOUBLE_PRECISION (always for a pole on or outside
+// the unit circle). Never MIXED_PRECISION, which is slower than double.
+precision_t choosePrecision(const std::vector<Biquad>& sections);
+
+std::unique_ptr<TopologyBank> makeSinglePrecisionBank(const std::vector<Biquad>& biquads, size_t channels);
+std::unique_ptr<TopologyBank> makeMixedPrecisionBank(const std::vector<Biquad>& biquads, size_t channels);
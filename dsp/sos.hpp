@@ -0,0 +1,143 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* SosCascade
+* Cascade of second-order sections run as transposed direct form II.
+* Sections are stored and evaluated in order; the overall gain is folded
+* into the numerator of the first section. Samples go through either one at a
+* time (processSample) or a block at a time (process).
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// H(z) = (b0 + b1 z^-1 + b2 z^-2) / (1 + a1 z^-1 + a2 z^-2)
+struct Biquad {
+	double b0, b1, b2;
+	double a1, a2;
+};
+
+class SosCascade {
+	public:
+		SosCascade() = default;
+		explicit SosCascade(std::vector<Biquad> biquads)
+			: sections(std::move(biquads)), state(2 * sections.size(), 0.0) {}
+
+		double processSample(double input) {
+			const Biquad* sec = sections.data();
+			double* z = state.data();
+			const size_t count = sections.size();
+			double x = input;
+			for (size_t i = 0; i < count; ++i, z += 2) {
+				const Biquad& c = sec[i];
+				const double y = c.b0 * x + z[0];
+				z[0] = c.b1 * x - c.a1 * y + z[1];
+				z[1] = c.b2 * x - c.a2 * y;
+				x = y;
+			}
+			return x;
+		}
+
+		// A block of samples; in and out may be the same buffer. Sections run
+		// up to eight at a time with their state held in registers for the
+		// whole block, which leaves the CPU independent recursions to overlap.
+		// Gives exactly the same result as processSample().
+		void process(const double* in, double* out, size_t count) {
+			const size_t num_sections = sections.size();
+			if (num_sections == 0) {
+				if (in != out) { std::copy(in, in + count, out); }
+				return;
+			}
+			const double* src = in;
+			for (size_t i = 0; i < num_sections; i += 8, src = out) {
+				switch (std::min<size_t>(num_sections - i, 8)) {
+					case 1: runSections<1>(i, src, out, count); break;
+					case 2: runSections<2>(i, src, out, count); break;
+					case 3: runSections<3>(i, src, out, count); break;
+					case 4: runSections<4>(i, src, out, count); break;
+					case 5: runSections<5>(i, src, out, count); break;
+					case 6: runSections<6>(i, src, out, count); break;
+					case 7: runSections<7>(i, src, out, count); break;
+					default: runSections<8>(i, src, out, count); break;
+				}
+			}
+		}
+
+		void processInPlace(double* data, size_t count) { process(data, data, count); }
+
+		void reset() { state.assign(state.size(), 0.0); }
+
+		// Load the state the cascade settles into after a long run of constant
+		// input, so that starting on that value gives no transient. Sections
+		// with a pole at DC never settle and are left at zero.
+		void setSteadyState(double input) {
+			double x = input;
+			for (size_t i = 0; i < sections.size(); ++i) {
+				const Biquad& c = sections[i];
+				const double denom = 1 + c.a1 + c.a2;
+				if (denom == 0) {
+					state[2 * i] = 0;
+					state[2 * i + 1] = 0;
+					continue;
+				}
+				const double y = (c.b0 + c.b1 + c.b2) / denom * x;
+				state[2 * i + 1] = c.b2 * x - c.a2 * y;
+				state[2 * i] = c.b1 * x - c.a1 * y + state[2 * i + 1];
+				x = y;
+			}
+		}
+
+		size_t numSections() const { return sections.size(); }
+		const std::vector<Biquad>& getSections() const { return sections; }
+
+	private:
+		template<size_t K>
+		void runSections(size_t first, const double* src, double* out, size_t count) {
+			Biquad c[K];
+			double z1[K];
+			double z2[K];
+			for (size_t k = 0; k < K; ++k) {
+				c[k] = sections[first + k];
+				z1[k] = state[2 * (first + k)];
+				z2[k] = state[2 * (first + k) + 1];
+			}
+			for (size_t n = 0; n < count; ++n) {
+				double x = src[n];
+#pragma GCC unroll 8
+				for (size_t k = 0; k < K; ++k) {
+					const double y = c[k].b0 * x + z1[k];
+					z1[k] = c[k].b1 * x - c[k].a1 * y + z2[k];
+					z2[k] = c[k].b2 * x - c[k].a2 * y;
+					x = y;
+				}
+				out[n] = x;
+			}
+			for (size_t k = 0; k < K; ++k) {
+				state[2 * (first + k)] = z1[k];
+				state[2 * (first + k) + 1] = z2[k];
+			}
+		}
+
+		std::vector<Biquad> sections;
+		std::vector<double> state; // z1, z2 per section, contiguous
+};
@@ -0,0 +1,360 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "coefficient-pool.hpp"
+#include "topologies.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TOPOLOGIES_X86 1
+#endif
+
+namespace {
+
+constexpr size_t ALIGNMENT = 64; // one cache line, one AVX-512 register
+constexpr size_t MAX_LANES = 8; // doubles per AVX-512 register
+
+typedef double Lanes4 __attribute__((vector_size(4 * sizeof(double))));
+typedef double Lanes8 __attribute__((vector_size(8 * sizeof(double))));
+
+template<typename V>
+inline V& at(double* z) { return *reinterpret_cast<V*>(z); }
+
+// Each form steps x through one section for LANES channels: z points at the
+// section's two state rows (stride apart) and, for direct form I, the next
+// section's rows follow. finish() runs once after the last section.
+
+// rows: x[n-1], x[n-2] of the section's input; the next section's rows are
+// this section's y[n-1], y[n-2]
+struct Df1Form {
+	using Section = Biquad;
+	static constexpr size_t EXTRA_ROWS = 2; // the output of the last section
+
+	template<typename V>
+	static inline __attribute__((always_inline)) void step(const Biquad& c, V& x, double* z, size_t stride) {
+		V& x1 = at<V>(z);
+		V& x2 = at<V>(z + stride);
+		const V y1 = at<V>(z + 2 * stride);
+		const V y2 = at<V>(z + 3 * stride);
+		const V y = c.b0 * x + c.b1 * x1 + c.b2 * x2 - c.a1 * y1 - c.a2 * y2;
+		x2 = x1;
+		x1 = x;
+		x = y;
+	}
+	template<typename V>
+	static inline __attribute__((always_inline)) void finish(const V& y, double* z, size_t stride) {
+		at<V>(z + stride) = at<V>(z);
+		at<V>(z) = y;
+	}
+	static Section convert(const Biquad& c) { return c; }
+};
+
+// rows: g0[n-1], g1[n-1]
+struct LatticeForm {
+	using Section = LatticeSection;
+	static constexpr size_t EXTRA_ROWS = 0;
+
+	template<typename V>
+	static inline __attribute__((always_inline)) void step(const LatticeSection& c, V& x, double* z, size_t stride) {
+		V& s0 = at<V>(z);
+		V& s1 = at<V>(z + stride);
+		const V f1 = x - c.k2 * s1;
+		const V g2 = c.k2 * f1 + s1;
+		const V f0 = f1 - c.k1 * s0;
+		const V g1 = c.k1 * f0 + s0;
+		const V y = c.c0 * f0 + c.c1 * g1 + c.c2 * g2;
+		s1 = g1;
+		s0 = f0;
+		x = y;
+	}
+	template<typename V>
+	static inline __attribute__((always_inline)) void finish(const V&, double*, size_t) {}
+	static Section convert(const Biquad& c) { return toLattice(c); }
+};
+
+// rows: s1, s2
+struct StateVariableForm {
+	using Section = StateSpaceSection;
+	static constexpr size_t EXTRA_ROWS = 0;
+
+	template<typename V>
+	static inline __attribute__((always_inline)) void step(const StateSpaceSection& c, V& x, double* z, size_t stride) {
+		V& s1 = at<V>(z);
+		V& s2 = at<V>(z + stride);
+		const V y = c.c1 * s1 + c.c2 * s2 + c.d * x;
+		const V n1 = c.a11 * s1 + c.a12 * s2 + c.b1 * x;
+		const V n2 = c.a21 * s1 + c.a22 * s2 + c.b2 * x;
+		s1 = n1;
+		s2 = n2;
+		x = y;
+	}
+	template<typename V>
+	static inline __attribute__((always_inline)) void finish(const V&, double*, size_t) {}
+	static Section convert(const Biquad& c) { return toStateSpace(c); }
+};
+
+template<typename Form, typename V, size_t LANES>
+inline __attribute__((always_inline)) size_t tickKernel(const typename Form::Section* sections,
+	size_t num_sections, double* state, size_t stride, const double* in, double* out,
+	size_t first, size_t channels) {
+	size_t ch = first;
+	for (; ch + LANES <= channels; ch += LANES) {
+		V x;
+		std::memcpy(&x, in + ch, sizeof(V));
+		double* z = state + ch;
+		for (size_t s = 0; s < num_sections; ++s, z += 2 * stride) {
+			Form::template step<V>(sections[s], x, z, stride);
+		}
+		Form::template finish<V>(x, z, stride);
+		std::memcpy(out + ch, &x, sizeof(V));
+	}
+	return ch;
+}
+
+template<typename Form>
+using Kernel = void (*)(const typename Form::Section* sections, size_t num_sections,
+	double* state, size_t stride, const double* in, double* out, size_t channels, size_t frames);
+
+// frames ticks; each frame is finished for every channel before the next
+// starts, so in and out may be the same buffer
+template<typename Form>
+void scalarKernel(const typename Form::Section* sections, size_t num_sections, double* state,
+	size_t stride, const double* in, double* out, size_t channels, size_t frames) {
+	for (size_t f = 0; f < frames; ++f) {
+		tickKernel<Form, double, 1>(sections, num_sections, state, stride,
+			in + f * channels, out + f * channels, 0, channels);
+	}
+}
+
+#ifdef TOPOLOGIES_X86
+template<typename Form>
+__attribute__((target("avx2")))
+void avx2Kernel(const typename Form::Section* sections, size_t num_sections, double* state,
+	size_t stride, const double* in, double* out, size_t channels, size_t frames) {
+	for (size_t f = 0; f < frames; ++f) {
+		const double* src = in + f * channels;
+		double* dst = out + f * channels;
+		size_t done = tickKernel<Form, Lanes4, 4>(sections, num_sections, state, stride, src, dst, 0, channels);
+		tickKernel<Form, double, 1>(sections, num_sections, state, stride, src, dst, done, channels);
+	}
+}
+
+template<typename Form>
+__attribute__((target("avx512f")))
+void avx512Kernel(const typename Form::Section* sections, size_t num_sections, double* state,
+	size_t stride, const double* in, double* out, size_t channels, size_t frames) {
+	for (size_t f = 0; f < frames; ++f) {
+		const double* src = in + f * channels;
+		double* dst = out + f * channels;
+		size_t done = tickKernel<Form, Lanes8, 8>(sections, num_sections, state, stride, src, dst, 0, channels);
+		done = tickKernel<Form, Lanes4, 4>(sections, num_sections, state, stride, src, dst, done, channels);
+		tickKernel<Form, double, 1>(sections, num_sections, state, stride, src, dst, done, channels);
+	}
+}
+#endif
+
+template<typename Form>
+Kernel<Form> bestKernel(const char*& name) {
+#ifdef TOPOLOGIES_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		name = "avx512";
+		return avx512Kernel<Form>;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		name = "avx2";
+		return avx2Kernel<Form>;
+	}
+#endif
+	name = "scalar";
+	return scalarKernel<Form>;
+}
+
+template<typename Form>
+class FormBank : public TopologyBank {
+	public:
+		FormBank(const std::vector<Biquad>& biquads, size_t channels)
+			: num_channels(channels), stride((channels + MAX_LANES - 1) / MAX_LANES * MAX_LANES),
+			rows(2 * biquads.size() + Form::EXTRA_ROWS)
+		{
+			std::vector<typename Form::Section> converted;
+			for (const Biquad& c : biquads) {
+				converted.push_back(Form::convert(c));
+			}
+			sections = CoefficientPool::instance().intern(converted);
+			kernel = bestKernel<Form>(kernel_name);
+			const size_t bytes = std::max<size_t>(rows * stride * sizeof(double), ALIGNMENT);
+			state.reset(static_cast<double*>(std::aligned_alloc(ALIGNMENT, (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT)));
+			reset();
+		}
+
+		void process(const double* in, double* out) override {
+			kernel(sections.data(), sections.size(), state.get(), stride, in, out, num_channels, 1);
+		}
+		void process(const double* in, double* out, size_t frames) override {
+			kernel(sections.data(), sections.size(), state.get(), stride, in, out, num_channels, frames);
+		}
+		void reset() override {
+			std::memset(state.get(), 0, rows * stride * sizeof(double));
+		}
+		void setSteadyState(const double* input) override;
+		size_t numChannels() const override { return num_channels; }
+		const char* kernelName() const override { return kernel_name; }
+
+	private:
+		struct Free { void operator()(double* p) const { std::free(p); } };
+
+		SharedCoefficients<typename Form::Section> sections; // read-only, shared
+		size_t num_channels;
+		size_t stride; // channels rounded up to the widest vector
+		size_t rows; // state rows of stride doubles
+		std::unique_ptr<double[], Free> state;
+		Kernel<Form> kernel = nullptr;
+		const char* kernel_name = "";
+};
+
+// Every form settles to the same section outputs; sections with a pole at DC
+// never settle and are left at zero, passing their input on, as SosCascade
+// does.
+template<>
+void FormBank<Df1Form>::setSteadyState(const double* input) {
+	for (size_t ch = 0; ch < num_channels; ++ch) {
+		double x = input[ch];
+		double* z = state.get() + ch;
+		z[0] = x;
+		z[stride] = x;
+		for (size_t s = 0; s < sections.size(); ++s) {
+			const Biquad& c = sections[s];
+			const double denom = 1 + c.a1 + c.a2;
+			if (denom != 0) { x = (c.b0 + c.b1 + c.b2) / denom * x; }
+			z += 2 * stride;
+			z[0] = x;
+			z[stride] = x;
+		}
+	}
+}
+
+template<>
+void FormBank<LatticeForm>::setSteadyState(const double* input) {
+	for (size_t ch = 0; ch < num_channels; ++ch) {
+		double x = input[ch];
+		double* z = state.get() + ch;
+		for (size_t s = 0; s < sections.size(); ++s, z += 2 * stride) {
+			const LatticeSection& c = sections[s];
+			if (1 + c.k1 == 0 || 1 + c.k2 == 0) {
+				z[0] = 0;
+				z[stride] = 0;
+				continue;
+			}
+			const double f1 = x / (1 + c.k2);
+			const double s0 = f1 / (1 + c.k1);
+			z[0] = s0;
+			z[stride] = f1;
+			x = c.c0 * s0 + c.c1 * f1 + c.c2 * (c.k2 * f1 + f1);
+		}
+	}
+}
+
+template<>
+void FormBank<StateVariableForm>::setSteadyState(const double* input) {
+	for (size_t ch = 0; ch < num_channels; ++ch) {
+		double x = input[ch];
+		double* z = state.get() + ch;
+		for (size_t s = 0; s < sections.size(); ++s, z += 2 * stride) {
+			// s = (I - A)^-1 B x
+			const StateSpaceSection& c = sections[s];
+			const double det = (1 - c.a11) * (1 - c.a22) - c.a12 * c.a21;
+			if (det == 0) {
+				z[0] = 0;
+				z[stride] = 0;
+				continue;
+			}
+			const double s1 = ((1 - c.a22) * c.b1 + c.a12 * c.b2) / det * x;
+			const double s2 = (c.a21 * c.b1 + (1 - c.a11) * c.b2) / det * x;
+			z[0] = s1;
+			z[stride] = s2;
+			x = c.c1 * s1 + c.c2 * s2 + c.d * x;
+		}
+	}
+}
+
+} // namespace
+
+// Gray-Markel step-down for 1 + a1 z^-1 + a2 z^-2, then the ladder taps that
+// rebuild the numerator from the lattice's backward outputs
+LatticeSection toLattice(const Biquad& c) {
+	LatticeSection result{};
+	result.k2 = c.a2;
+	result.k1 = c.a1 / (1 + c.a2);
+	result.c2 = c.b2;
+	result.c1 = c.b1 - result.c2 * c.a1;
+	result.c0 = c.b0 - result.c2 * c.a2 - result.c1 * result.k1;
+	return result;
+}
+
+// b0 plus a strictly proper remainder (r1 z + r2) / (z^2 + a1 z + a2),
+// realized in the coupled form for complex poles sigma +- j omega, or a
+// triangular form for real poles (which also covers repeated poles and
+// first-order sections)
+StateSpaceSection toStateSpace(const Biquad& c) {
+	StateSpaceSection result{};
+	const double r1 = c.b1 - c.b0 * c.a1;
+	const double r2 = c.b2 - c.b0 * c.a2;
+	result.d = c.b0;
+	const double disc = c.a1 * c.a1 - 4 * c.a2;
+	if (disc < 0) {
+		const double sigma = -c.a1 / 2;
+		const double omega = std::sqrt(-disc) / 2;
+		result.a11 = sigma;
+		result.a12 = -omega;
+		result.a21 = omega;
+		result.a22 = sigma;
+		result.b1 = 1;
+		result.b2 = 0;
+		result.c1 = r1;
+		result.c2 = (r2 + sigma * r1) / omega;
+	} else {
+		const double root = std::sqrt(disc);
+		const double p1 = (-c.a1 + root) / 2;
+		const double p2 = (-c.a1 - root) / 2;
+		result.a11 = p1;
+		result.a12 = 1;
+		result.a21 = 0;
+		result.a22 = p2;
+		result.b1 = 0;
+		result.b2 = 1;
+		result.c1 = r2 + r1 * p1;
+		result.c2 = r1;
+	}
+	return result;
+}
+
+std::unique_ptr<TopologyBank> makeDf1Bank(const std::vector<Biquad>& biquads, size_t channels) {
+	return std::make_unique<FormBank<Df1Form>>(biquads, channels);
+}
+
+std::unique_ptr<TopologyBank> makeLatticeBank(const std::vector<Biquad>& biquads, size_t channels) {
+	return std::make_unique<FormBank<LatticeForm>>(biquads, channels);
+}
+
+std::unique_ptr<TopologyBank> makeStateVariableBank(const std::vector<Biquad>& biquads, size_t channels) {
+	return std::make_unique<FormBank<StateVariableForm>>(biquads, channels);
+}
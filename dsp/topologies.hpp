@@ -0,0 +1,86 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* TopologyBank
+* The same cascade of second-order sections as SosBank (transposed direct
+* form II) realized in other structures, each a different trade between
+* speed and numerical robustness:
+*
+*   direct form I: four delays per section, two of them shared with the next
+*     section; the state holds only past inputs and outputs, so it cannot
+*     overflow internally, at the cost of more multiplies per state.
+*   lattice-ladder: two reflection coefficients and three ladder taps per
+*     section (Gray-Markel); stable as long as |k| < 1, and less sensitive to
+*     coefficient rounding for poles near the unit circle.
+*   state variable: a 2x2 state-space realization per section, the coupled
+*     (normal) form for complex poles; rounding noise does not grow as the
+*     poles approach z = 1, which suits cutoffs far below the sample rate.
+*
+* Like SosBank, channels run side by side in vector registers with the kernel
+* picked once for the CPU (AVX-512, AVX2 or scalar), state is kept
+* structure-of-arrays, and nothing allocates after construction. The
+* converted sections are interned in the CoefficientPool, so banks built
+* from the same design share them.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "sos.hpp"
+
+class TopologyBank {
+	public:
+		virtual ~TopologyBank() = default;
+
+		// one sample per channel, in[channel] -> out[channel]
+		virtual void process(const double* in, double* out) = 0;
+		// frames ticks, each frame holding one sample per channel; in and out
+		// may be the same buffer
+		virtual void process(const double* in, double* out, size_t frames) = 0;
+
+		virtual void reset() = 0;
+		// each channel's state as if input[channel] had been applied forever
+		virtual void setSteadyState(const double* input) = 0;
+
+		virtual size_t numChannels() const = 0;
+		virtual const char* kernelName() const = 0;
+};
+
+// y = c0 g0 + c1 g1 + c2 g2 over a two-stage all-pole lattice
+struct LatticeSection {
+	double k1, k2; // reflection coefficients
+	double c0, c1, c2; // ladder taps
+};
+
+// s' = A s + B x, y = C s + D x
+struct StateSpaceSection {
+	double a11, a12, a21, a22;
+	double b1, b2;
+	double c1, c2;
+	double d;
+};
+
+LatticeSection toLattice(const Biquad& section);
+StateSpaceSection toStateSpace(const Biquad& section);
+
+std::unique_ptr<TopologyBank> makeDf1Bank(const std::vector<Biquad>& biquads, size_t channels);
+std::unique_ptr<TopologyBank> makeLatticeBank(const std::vector<Biquad>& biquads, size_t channels);
+std::unique_ptr<TopologyBank> makeStateVariableBank(const std::vector<Biquad>& biquads, size_t channels);
@@ -0,0 +1,83 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <algorithm>
+#include "zero-phase.hpp"
+
+namespace {
+
+constexpr size_t CHUNK_SAMPLES = 2048; // stays in L1 alongside the section state
+
+// scipy's default: three times the length of the impulse response's
+// polynomial, less the trailing zeros a first-order section leaves
+size_t defaultPadLength(const std::vector<Biquad>& sections) {
+	size_t zero_b2 = 0;
+	size_t zero_a2 = 0;
+	for (const Biquad& section : sections) {
+		if (section.b2 == 0) { zero_b2++; }
+		if (section.a2 == 0) { zero_a2++; }
+	}
+	return 3 * (2 * sections.size() + 1 - std::min(zero_b2, zero_a2));
+}
+
+} // namespace
+
+ZeroPhaseFilter::ZeroPhaseFilter(std::vector<Biquad> biquads)
+	: cascade(std::move(biquads)), chunk(CHUNK_SAMPLES)
+{
+	pad_length = defaultPadLength(cascade.getSections());
+	left_pad.resize(pad_length);
+	right_pad.resize(pad_length);
+}
+
+void ZeroPhaseFilter::run(const double* src, double* dst, ptrdiff_t step, size_t count) {
+	for (size_t done = 0; done < count; done += CHUNK_SAMPLES) {
+		const size_t n = std::min(CHUNK_SAMPLES, count - done);
+		const ptrdiff_t offset = static_cast<ptrdiff_t>(done) * step;
+		for (size_t i = 0; i < n; i++) { chunk[i] = src[offset + static_cast<ptrdiff_t>(i) * step]; }
+		cascade.processInPlace(chunk.data(), n);
+		for (size_t i = 0; i < n; i++) { dst[offset + static_cast<ptrdiff_t>(i) * step] = chunk[i]; }
+	}
+}
+
+void ZeroPhaseFilter::process(const double* in, double* out, size_t count, size_t stride) {
+	if (count == 0) { return; }
+	const ptrdiff_t step = static_cast<ptrdiff_t>(stride);
+	const size_t pad = std::min(pad_length, count - 1);
+	const double first = in[0];
+	const double last = in[(count - 1) * stride];
+
+	// odd reflections about the end samples, taken before out overwrites in
+	for (size_t i = 0; i < pad; i++) {
+		left_pad[i] = 2 * first - in[(pad - i) * stride];
+		right_pad[i] = 2 * last - in[(count - 2 - i) * stride];
+	}
+
+	// forward: left pad (output dropped), signal, right pad
+	cascade.setSteadyState(pad > 0 ? left_pad[0] : first);
+	cascade.processInPlace(left_pad.data(), pad);
+	run(in, out, step, count);
+	cascade.processInPlace(right_pad.data(), pad);
+
+	// backward: right pad reversed (output dropped), then the signal reversed
+	std::reverse(right_pad.begin(), right_pad.begin() + pad);
+	cascade.setSteadyState(pad > 0 ? right_pad[0] : out[(count - 1) * stride]);
+	cascade.processInPlace(right_pad.data(), pad);
+	double* end = out + (count - 1) * stride;
+	run(end, end, -step, count);
+}
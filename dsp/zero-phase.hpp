@@ -0,0 +1,58 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* ZeroPhaseFilter
+* Forward-backward ("filtfilt") filtering with a cascade of second-order
+* sections, for recordings rather than live signals: the magnitude response is
+* squared and the phase cancels. As in scipy.signal.sosfiltfilt, the signal is
+* padded at both ends by odd reflection and each pass starts from the steady
+* state for the first sample it sees, so neither edge rings.
+*
+* Both passes stream through a small fixed chunk, so the only buffer the size
+* of the signal is the output (which may be the input).
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "sos.hpp"
+
+class ZeroPhaseFilter {
+	public:
+		explicit ZeroPhaseFilter(std::vector<Biquad> biquads);
+
+		// count samples, stride apart in both in and out; in and out may be
+		// the same buffer
+		void process(const double* in, double* out, size_t count, size_t stride = 1);
+
+		// samples reflected onto each end (fewer for short signals)
+		size_t padLength() const { return pad_length; }
+
+	private:
+		// run the cascade from src to dst, step elements apart (negative to walk
+		// backwards), one chunk at a time
+		void run(const double* src, double* dst, ptrdiff_t step, size_t count);
+
+		SosCascade cascade;
+		size_t pad_length;
+		std::vector<double> chunk;
+		std::vector<double> left_pad;
+		std::vector<double> right_pad;
+};
@@ -27,7 +27,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <algorithm>
 #include <numeric>
 #include <time.h>
-#include <DSP/log2.h>
 #include <sys/stat.h>
 
 //create plug-in
@@ -79,7 +78,10 @@ IIRfilter::~IIRfilter(void) {}
 
 //execute, the code block that actually does the signal processing
 void IIRfilter::execute(void) {
-	output(0) = filter_implem->ProcessSample(input(0));
+	const double in = input(0);
+	double out;
+	filter->process(&in, &out);
+	output(0) = out;
 	return;
 }
 
@@ -91,8 +93,8 @@ void IIRfilter::update(DefaultGUIModel::update_flags_t flag) {
 			setParameter("Passband Edge (Hz)", QString::number(passband_edge));
 			setParameter("Stopband Ripple (dB)", QString::number(stopband_ripple));
 			setParameter("Stopband Edge (Hz)", QString::number(stopband_edge));
-			setParameter("Input quantizing factor", QString::number(ilog2(input_quan_factor)));
-			setParameter("Coefficients quantizing factor", QString::number(ilog2(coeff_quan_factor)));
+			setParameter("Input quantizing factor", QString::number(input_quan_bits));
+			setParameter("Coefficients quantizing factor", QString::number(coeff_quan_bits));
 			filterType->setCurrentIndex(filter_type);
 			break;
 	
@@ -103,9 +105,8 @@ void IIRfilter::update(DefaultGUIModel::update_flags_t flag) {
 			stopband_ripple = getParameter("Stopband Ripple (dB)").toDouble();
 			stopband_edge = getParameter("Stopband Edge (Hz)").toDouble();
 			filter_type = filter_t(filterType->currentIndex());
-			stopband_edge *= TWO_PI;
-			input_quan_factor = 2 ^ getParameter("Input quantizing factor").toInt(); // quantize input to 12 bits
-			coeff_quan_factor = 2 ^ getParameter("Coefficients quantizing factor").toInt(); // quantize filter coefficients to 12 bits
+			input_quan_bits = getParameter("Input quantizing factor").toInt();
+			coeff_quan_bits = getParameter("Coefficients quantizing factor").toInt();
 			makeFilter();
 			break;
 	
@@ -138,8 +139,8 @@ void IIRfilter::initParameters() {
 	ripple_bw_norm = 0;
 	predistort_enabled = true;
 	quant_enabled = false;
-	input_quan_factor = 4096; // quantize input to 12 bits
-	coeff_quan_factor = 4096; // quantize filter coefficients to 12 bits
+	input_quan_bits = 12; // quantize input to 12 bits
+	coeff_quan_bits = 12; // quantize filter coefficients to 12 bits
 	makeFilter();
 }
 
@@ -165,42 +166,22 @@ void IIRfilter::updateNormType(int index) {
 }
 
 void IIRfilter::makeFilter() {
-	switch (filter_type) {
-		case BUTTER:
-			analog_filter = new ButterworthTransFunc(filter_order);
-			analog_filter->LowpassDenorm(passband_edge);
-			break;
-
-		case CHEBY:
-			analog_filter = new ChebyshevTransFunc(filter_order, passband_ripple,
-			ripple_bw_norm);
-			analog_filter->LowpassDenorm(passband_edge);
-			break;
-	
-		case ELLIP:
-			int upper_summation_limit = 5;
-			analog_filter = new EllipticalTransFunc(filter_order, passband_ripple,
-			stopband_ripple, passband_edge, stopband_edge, upper_summation_limit);
-			break;
-	} // end of switch on window_shape
-	
-	if (predistort_enabled) analog_filter->FrequencyPrewarp(dt);
-	
-	filter_design = BilinearTransf(analog_filter, dt);
-	
-	if (quant_enabled) {
-		filter_implem = new DirectFormIir(filter_design->GetNumNumerCoeffs(),
-			filter_design->GetNumDenomCoeffs(),
-			filter_design->GetNumerCoefficients(),
-			filter_design->GetDenomCoefficients(), coeff_quan_factor,
-			input_quan_factor);
-	} else {
-		filter_implem = new UnquantDirectFormIir(
-			filter_design->GetNumNumerCoeffs(),
-			filter_design->GetNumDenomCoeffs(),
-			filter_design->GetNumerCoefficients(),
-			filter_design->GetDenomCoefficients());
-	}
+	FilterSpec spec{};
+	spec.filter_type = filter_type;
+	spec.filter_order = filter_order;
+	spec.passband_ripple = passband_ripple;
+	spec.stopband_ripple = stopband_ripple;
+	spec.passband_edge = passband_edge;
+	spec.stopband_edge = stopband_edge;
+	spec.ripple_bw_norm = ripple_bw_norm;
+	spec.quant_enabled = quant_enabled;
+	spec.predistort_enabled = predistort_enabled;
+	// the library's DirectFormIir takes 2^bits, as the component passes it
+	spec.input_quan_factor = quantization_factor(input_quan_bits);
+	spec.coeff_quan_factor = quantization_factor(coeff_quan_bits);
+	spec.implementation = DIRECT;
+	spec.dt = dt;
+	filter = ::makeFilter(spec);
 }
 
 void IIRfilter::saveIIRData() {
@@ -239,23 +220,20 @@ void IIRfilter::saveIIRData() {
 			}
 			stream << QString(" \n");
 			
-			double *numer_coeff = filter_design->GetNumerCoefficients();
-			double *denom_coeff = filter_design->GetDenomCoefficients();
+			const std::vector<double>& numer_coeff = filter->design->numer_coeff;
+			const std::vector<double>& denom_coeff = filter->design->denom_coeff;
 			
 			stream << QString("Filter numerator coefficients:\n");
-			for (int i = 0; i < filter_design->GetNumNumerCoeffs(); i++) {
+			for (size_t i = 0; i < numer_coeff.size(); i++) {
 				stream << QString("numer_coeff[") << i << "] = "
 					<< (double) numer_coeff[i] << "\n";
 			}
 			stream << QString("Filter denominator coefficients:\n");
-			for (int i = 0; i < filter_design->GetNumDenomCoeffs() + 1; i++) {
+			for (size_t i = 0; i < denom_coeff.size(); i++) {
 				stream << QString("denom_coeff[") << i << "] = "
 					<< (double) denom_coeff[i] << "\n";
 			}
 			dataFile.close();
-			
-			delete[] numer_coeff;
-			delete[] denom_coeff;
 		}
 		else {
 			QMessageBox::information(this, "IIR filter: Save filter parameters",
@@ -23,16 +23,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 * Elliptical: passband_ripple, stopband_ripple, passband_edge, stopband_edge
 */
 
+#include <memory>
 #include <default_gui_model.h>
-#include <DSP/iir_dsgn.h>
-#include <DSP/dir1_iir.h>
-#include <DSP/unq_iir.h>
-#include <DSP/buttfunc.h>
-#include <DSP/chebfunc.h>
-#include <DSP/elipfunc.h>
-#include <DSP/bilinear.h>
-
-#define TWO_PI 6.28318531
+#include "dsp/filter-design.hpp"
 
 class IIRfilter : public DefaultGUIModel {
 	Q_OBJECT
@@ -53,11 +46,7 @@ class IIRfilter : public DefaultGUIModel {
 	
 	private:	
 		// filter parameters
-		FilterTransFunc *analog_filter;
-		IirFilterDesign *filter_design;
-		FilterImplementation *filter_implem;
-	
-		double* h3; // filter coefficients
+		std::unique_ptr<FilterBlock> filter; // designed and built by the DSP library (dsp/)
 		filter_t filter_type; // type of filter
 		double passband_ripple; // dB?
 		double stopband_ripple; // dB?
@@ -68,8 +57,8 @@ class IIRfilter : public DefaultGUIModel {
 
 		bool quant_enabled; // quantize input signal and coefficients
 		bool predistort_enabled; // predistort frequencies for bilinear transform
-		int input_quan_factor; // quantization factor 2^bits for input signal
-		int coeff_quan_factor; // quantization factor 2^bits for filter coefficients
+		int input_quan_bits; // bits the input signal is quantized to
+		int coeff_quan_bits; // bits the filter coefficients are quantized to
 
 		// bookkeeping
 		double out; // bookkeeping for computing convolution
@@ -0,0 +1,155 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* CycleClock, LatencyHistogram
+* Timing for the real-time thread. CycleClock reads the CPU's time-stamp
+* counter (steady_clock elsewhere) and is calibrated against steady_clock once.
+* LatencyHistogram has a single writer, the real-time thread, which only does
+* relaxed loads and stores; any other thread may take a snapshot at any time
+* without stalling it. Buckets are log-linear: exact below 16 ns, then eight
+* per power of two (within 12.5%).
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLE_CLOCK_TSC 1
+#endif
+
+class CycleClock {
+	public:
+		static uint64_t now() {
+#ifdef CYCLE_CLOCK_TSC
+			return __rdtsc();
+#else
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+		}
+
+		// The first call spins for a few milliseconds to calibrate; make it
+		// outside the real-time thread.
+		static double nsPerTick() {
+			static const double ns_per_tick = calibrate();
+			return ns_per_tick;
+		}
+
+	private:
+		static double calibrate() {
+#ifdef CYCLE_CLOCK_TSC
+			using clock = std::chrono::steady_clock;
+			const auto t0 = clock::now();
+			const uint64_t c0 = now();
+			while (clock::now() - t0 < std::chrono::milliseconds(5)) {}
+			const uint64_t c1 = now();
+			const double ns = std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+			return c1 > c0 ? ns / static_cast<double>(c1 - c0) : 1.0;
+#else
+			return 1.0;
+#endif
+		}
+};
+
+class LatencyHistogram {
+	public:
+		static constexpr size_t LINEAR = 16; // one bucket per ns below this
+		static constexpr size_t SUB_BUCKETS = 8; // per power of two above
+		static constexpr size_t NUM_BUCKETS = LINEAR + (64 - 4) * SUB_BUCKETS;
+
+		struct Snapshot {
+			uint64_t count = 0;
+			uint64_t overruns = 0; // ticks longer than the real-time period
+			uint64_t min_ns = 0;
+			uint64_t max_ns = 0;
+			uint64_t p50_ns = 0; // upper edge of the bucket holding the percentile
+			uint64_t p99_ns = 0;
+			std::array<uint64_t, NUM_BUCKETS> buckets{};
+		};
+
+		// real-time side, one writer only
+		void record(uint64_t ns, bool overrun) {
+			bump(buckets[bucketOf(ns)]);
+			if (overrun) { bump(overruns); }
+			if (ns < min_ns.load(std::memory_order_relaxed)) { min_ns.store(ns, std::memory_order_relaxed); }
+			if (ns > max_ns.load(std::memory_order_relaxed)) { max_ns.store(ns, std::memory_order_relaxed); }
+		}
+
+		// any thread; counts recorded meanwhile may or may not be included
+		Snapshot snapshot() const {
+			Snapshot result;
+			for (size_t i = 0; i < NUM_BUCKETS; i++) {
+				result.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+				result.count += result.buckets[i];
+			}
+			result.overruns = overruns.load(std::memory_order_relaxed);
+			if (result.count == 0) { return result; }
+			result.min_ns = min_ns.load(std::memory_order_relaxed);
+			result.max_ns = max_ns.load(std::memory_order_relaxed);
+			result.p50_ns = std::min(result.max_ns, percentile(result, 0.5));
+			result.p99_ns = std::min(result.max_ns, percentile(result, 0.99));
+			return result;
+		}
+
+		// [bucketLow(i), bucketHigh(i)) ns
+		static uint64_t bucketLow(size_t i) {
+			if (i < LINEAR) { return i; }
+			const size_t exponent = 4 + (i - LINEAR) / SUB_BUCKETS;
+			const uint64_t sub = (i - LINEAR) % SUB_BUCKETS;
+			return (uint64_t{1} << exponent) + sub * (uint64_t{1} << (exponent - 3));
+		}
+		static uint64_t bucketHigh(size_t i) {
+			return i + 1 < NUM_BUCKETS ? bucketLow(i + 1) : std::numeric_limits<uint64_t>::max();
+		}
+
+	private:
+		static void bump(std::atomic<uint64_t>& counter) {
+			counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+
+		static size_t bucketOf(uint64_t ns) {
+			if (ns < LINEAR) { return static_cast<size_t>(ns); }
+			const size_t exponent = 63 - static_cast<size_t>(__builtin_clzll(ns));
+			const size_t sub = static_cast<size_t>(ns >> (exponent - 3)) & (SUB_BUCKETS - 1);
+			return LINEAR + (exponent - 4) * SUB_BUCKETS + sub;
+		}
+
+		static uint64_t percentile(const Snapshot& s, double fraction) {
+			const uint64_t rank = static_cast<uint64_t>(fraction * static_cast<double>(s.count - 1)) + 1;
+			uint64_t seen = 0;
+			for (size_t i = 0; i < NUM_BUCKETS; i++) {
+				seen += s.buckets[i];
+				if (seen >= rank) { return bucketHigh(i) - 1; }
+			}
+			return s.max_ns;
+		}
+
+		std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets{};
+		std::atomic<uint64_t> overruns{0};
+		std::atomic<uint64_t> min_ns{std::numeric_limits<uint64_t>::max()};
+		std::atomic<uint64_t> max_ns{0};
+};
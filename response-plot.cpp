@@ -0,0 +1,108 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QPolygonF>
+#include "response-plot.hpp"
+
+namespace {
+
+constexpr int MARGIN = 8; // pixels around the plot area
+constexpr int LABEL_WIDTH = 60; // room for the value labels on the left
+constexpr int LABEL_HEIGHT = 16; // room for the frequency labels below
+constexpr double MAGNITUDE_RANGE_DB = 120; // shown below the peak
+
+} // namespace
+
+ResponsePlot::ResponsePlot(QWidget* parent) : QWidget(parent) {
+	setMinimumSize(300, 180);
+}
+
+void ResponsePlot::setResponse(std::shared_ptr<const FrequencyResponse> new_response) {
+	response = std::move(new_response);
+	update();
+}
+
+void ResponsePlot::setView(int new_view) {
+	view = new_view;
+	update();
+}
+
+void ResponsePlot::paintEvent(QPaintEvent* /*event*/) {
+	QPainter painter(this);
+	painter.fillRect(rect(), Qt::white);
+	const QRectF area(LABEL_WIDTH, MARGIN, width() - LABEL_WIDTH - MARGIN,
+		height() - 2 * MARGIN - LABEL_HEIGHT);
+	painter.setPen(Qt::gray);
+	painter.drawRect(area);
+	if (response == nullptr || response->freq.size() < 2) {
+		painter.drawText(area, Qt::AlignCenter, "No design yet");
+		return;
+	}
+
+	const std::vector<double>& values = view == PHASE ? response->phase
+		: view == GROUP_DELAY ? response->group_delay : response->magnitude;
+	const double scale = view == GROUP_DELAY ? 1e3 : 1; // group delay in ms
+	const char* unit = view == PHASE ? "deg" : view == GROUP_DELAY ? "ms" : "dB";
+	const auto range = std::minmax_element(values.begin(), values.end());
+	double high = *range.second * scale;
+	double low = *range.first * scale;
+	if (view == MAGNITUDE) { low = std::max(low, high - MAGNITUDE_RANGE_DB); }
+	if (high - low < 1e-9) {
+		high += 1;
+		low -= 1;
+	}
+
+	const double first = std::log10(response->freq.front());
+	const double span = std::log10(response->freq.back()) - first;
+	auto x = [&](double freq) { return area.left() + area.width() * (std::log10(freq) - first) / span; };
+	auto y = [&](double value) {
+		const double clamped = std::min(high, std::max(low, value * scale));
+		return area.bottom() - area.height() * (clamped - low) / (high - low);
+	};
+
+	// a grid line per decade
+	painter.setPen(QPen(Qt::lightGray, 1, Qt::DashLine));
+	for (double decade = std::ceil(first); decade <= first + span; decade += 1) {
+		const double pos = x(std::pow(10.0, decade));
+		painter.drawLine(QPointF(pos, area.top()), QPointF(pos, area.bottom()));
+	}
+
+	QPolygonF line;
+	for (size_t i = 0; i < values.size(); i++) {
+		line << QPointF(x(response->freq[i]), y(values[i]));
+	}
+	painter.setRenderHint(QPainter::Antialiasing);
+	painter.setPen(QPen(Qt::blue, 1.5));
+	painter.drawPolyline(line);
+
+	painter.setPen(Qt::black);
+	const QRectF label_column(0, 0, LABEL_WIDTH - 4, LABEL_HEIGHT);
+	painter.drawText(label_column.translated(0, area.top()), Qt::AlignRight | Qt::AlignTop,
+		QString("%1 %2").arg(high, 0, 'g', 4).arg(unit));
+	painter.drawText(label_column.translated(0, area.bottom() - LABEL_HEIGHT), Qt::AlignRight | Qt::AlignBottom,
+		QString("%1 %2").arg(low, 0, 'g', 4).arg(unit));
+	const QRectF freq_row(area.left(), area.bottom() + 2, area.width(), LABEL_HEIGHT);
+	painter.drawText(freq_row, Qt::AlignLeft | Qt::AlignTop,
+		QString("%1 Hz").arg(response->freq.front(), 0, 'g', 3));
+	painter.drawText(freq_row, Qt::AlignRight | Qt::AlignTop,
+		QString("%1 Hz").arg(response->freq.back(), 0, 'g', 4));
+}
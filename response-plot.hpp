@@ -0,0 +1,50 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* ResponsePlot
+* Draws one FrequencyResponse (magnitude, phase or group delay) against a
+* logarithmic frequency axis. It only paints what it is handed; the response
+* itself is computed on the design thread.
+*/
+
+#pragma once
+
+#include <memory>
+#include <QWidget>
+#include "dsp/response.hpp"
+
+class QPaintEvent;
+
+class ResponsePlot : public QWidget {
+	public:
+		enum View { MAGNITUDE=0, PHASE, GROUP_DELAY };
+
+		explicit ResponsePlot(QWidget* parent = nullptr);
+
+		void setResponse(std::shared_ptr<const FrequencyResponse> new_response);
+		const std::shared_ptr<const FrequencyResponse>& getResponse() const { return response; }
+		void setView(int new_view);
+
+	protected:
+		void paintEvent(QPaintEvent* event) override;
+
+	private:
+		std::shared_ptr<const FrequencyResponse> response;
+		int view = MAGNITUDE;
+};
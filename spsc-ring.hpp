@@ -0,0 +1,78 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* SpscRing
+* Wait-free single producer / single consumer queue of values with a fixed
+* capacity, allocated once. Unlike TripleBuffer nothing is overwritten: a
+* push that does not fit is refused whole, so the producer (the real-time
+* thread) never waits and the consumer sees every value it accepted, in
+* order. The two indices live on separate cache lines and count up forever,
+* masked into the buffer, so full and empty are told apart without a spare
+* slot.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+template<typename T>
+class SpscRing {
+	public:
+		// room for at least capacity values, rounded up to a power of two
+		explicit SpscRing(size_t capacity) {
+			size = 1;
+			while (size < capacity) { size <<= 1; }
+			buffer = std::make_unique<T[]>(size);
+		}
+
+		// producer side: all count values, or none if they do not fit
+		bool push(const T* values, size_t count) {
+			const size_t tail = write_index.load(std::memory_order_relaxed);
+			if (size - (tail - read_index.load(std::memory_order_acquire)) < count) { return false; }
+			const size_t start = tail & (size - 1);
+			const size_t first = std::min(count, size - start);
+			std::copy(values, values + first, buffer.get() + start);
+			std::copy(values + first, values + count, buffer.get());
+			write_index.store(tail + count, std::memory_order_release);
+			return true;
+		}
+
+		// consumer side: up to max values into out, returns how many
+		size_t pop(T* out, size_t max) {
+			const size_t head = read_index.load(std::memory_order_relaxed);
+			const size_t count = std::min(max, write_index.load(std::memory_order_acquire) - head);
+			const size_t start = head & (size - 1);
+			const size_t first = std::min(count, size - start);
+			std::copy(buffer.get() + start, buffer.get() + start + first, out);
+			std::copy(buffer.get(), buffer.get() + (count - first), out + first);
+			read_index.store(head + count, std::memory_order_release);
+			return count;
+		}
+
+		size_t capacity() const { return size; }
+
+	private:
+		std::unique_ptr<T[]> buffer;
+		size_t size;
+		alignas(64) std::atomic<size_t> write_index{0}; // written by the producer
+		alignas(64) std::atomic<size_t> read_index{0}; // written by the consumer
+};
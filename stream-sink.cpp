@@ -0,0 +1,114 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "stream-sink.hpp"
+
+namespace {
+
+// the most one write(2) is given
+constexpr size_t BATCH_BYTES = 1 << 20;
+// how long the writer sleeps when the ring is empty
+constexpr auto POLL_INTERVAL = std::chrono::milliseconds(5);
+
+bool writeAll(int fd, const unsigned char* data, size_t size) {
+	while (size > 0) {
+		const ssize_t count = write(fd, data, size);
+		if (count < 0) {
+			if (errno == EINTR) { continue; }
+			return false;
+		}
+		data += count;
+		size -= static_cast<size_t>(count);
+	}
+	return true;
+}
+
+} // namespace
+
+StreamSink::StreamSink(size_t channels, size_t ring_frames)
+	: frame_values(2 * channels), ring(ring_frames * 2 * channels), frame(2 * channels, 0.0) {}
+
+StreamSink::~StreamSink()
+{
+	if (writer.joinable()) {
+		quit.store(true, std::memory_order_release);
+		writer.join();
+	}
+	if (fd >= 0) { close(fd); }
+}
+
+bool StreamSink::open(const std::string& file_path, std::string& reason)
+{
+	fd = ::open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		reason = file_path + ": " + std::strerror(errno);
+		return false;
+	}
+	path = file_path;
+	writer = std::thread(&StreamSink::writeLoop, this);
+	return true;
+}
+
+bool StreamSink::push(const double* in, const double* out)
+{
+	const size_t channels = frame_values / 2;
+	std::copy(in, in + channels, frame.begin());
+	std::copy(out, out + channels, frame.begin() + static_cast<std::ptrdiff_t>(channels));
+	if (!ring.push(frame.data(), frame_values)) {
+		dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+std::string StreamSink::getError() const
+{
+	std::unique_lock<std::mutex> lock(error_mutex);
+	return error;
+}
+
+// Frames are pushed whole and batch holds whole frames, so every pop is
+// whole frames. Quitting is read before the ring, so everything pushed before
+// the destructor started is still written.
+void StreamSink::writeLoop()
+{
+	std::vector<double> batch(std::max<size_t>(BATCH_BYTES / sizeof(double) / frame_values, 1) * frame_values);
+	bool failed = false;
+	for (;;) {
+		const bool quitting = quit.load(std::memory_order_acquire);
+		const size_t count = ring.pop(batch.data(), batch.size());
+		if (count == 0) {
+			if (quitting) { break; }
+			std::this_thread::sleep_for(POLL_INTERVAL);
+			continue;
+		}
+		if (!failed && !writeAll(fd, reinterpret_cast<const unsigned char*>(batch.data()), count * sizeof(double))) {
+			const int reason = errno;
+			std::unique_lock<std::mutex> lock(error_mutex);
+			error = path + ": " + std::strerror(reason);
+			failed = true;
+		}
+		(failed ? lost : written).fetch_add(count / frame_values, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,84 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* StreamSink
+* Saving filter data to file without the Data Recorder: a tap of every
+* channel's input and output. The real-time thread hands each tick's frame
+* to push(), which copies it into an SpscRing and returns; a frame that does
+* not fit is dropped and counted, never waited for. A writer thread drains
+* the ring in batches of up to a megabyte per write(2). It polls rather than
+* being woken, so pushing makes no system call.
+*
+* The file is headerless float64, one frame per tick: every input, then
+* every output. That is the raw format iir-filter-offline and
+* iir-filter-replay read (with twice the channels).
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "spsc-ring.hpp"
+
+class StreamSink {
+	public:
+		// room for ring_frames frames of channels inputs and outputs
+		StreamSink(size_t channels, size_t ring_frames);
+		// drains what was pushed, then stops the writer and closes the file
+		~StreamSink();
+		StreamSink(const StreamSink&) = delete;
+		StreamSink& operator=(const StreamSink&) = delete;
+
+		// Create (or truncate) path and start the writer. On failure returns
+		// false with a reason in error.
+		bool open(const std::string& path, std::string& error);
+
+		// real-time thread: one sample per channel each; false if dropped
+		bool push(const double* in, const double* out);
+
+		const std::string& getPath() const { return path; }
+		uint64_t framesWritten() const { return written.load(std::memory_order_relaxed); }
+		// full ring, or lost to a failed write
+		uint64_t framesDropped() const {
+			return dropped.load(std::memory_order_relaxed) + lost.load(std::memory_order_relaxed);
+		}
+		// the write that failed, empty if none has
+		std::string getError() const;
+
+	private:
+		void writeLoop();
+
+		size_t frame_values; // 2 * channels
+		SpscRing<double> ring;
+		std::vector<double> frame; // owned by the real-time thread
+		std::string path;
+		int fd = -1;
+		std::thread writer;
+		std::atomic<bool> quit{false};
+		std::atomic<uint64_t> written{0}; // by the writer
+		std::atomic<uint64_t> dropped{0}; // ring full, by the real-time thread
+		std::atomic<uint64_t> lost{0}; // after a failed write, by the writer
+		mutable std::mutex error_mutex;
+		std::string error; // guarded by error_mutex
+};
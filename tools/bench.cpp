@@ -0,0 +1,228 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* iir-filter-bench
+* Times every filter type, order, quantization mode, implementation (sections
+* in each precision) and block size the plugin can run, without RTXI. One
+* result row per combination on stdout, as CSV (default) or JSON lines.
+*
+* usage: iir-filter-bench [--rate Hz] [--samples n] [--min-order n]
+*                         [--max-order n] [--channels n] [--blocks a,b,c]
+*                         [--format csv|json]
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+#include "../dsp/filter-design.hpp"
+#include "../dsp/implementation-timing.hpp"
+
+namespace {
+
+struct Options {
+	double rate = 20000; // Hz
+	size_t samples = 1 << 18; // per channel, per combination
+	int min_order = 2;
+	int max_order = 20;
+	size_t channels = 1;
+	std::vector<size_t> blocks = {1, 16, 64, 256, 1024};
+	bool json = false;
+};
+
+struct Result {
+	double ns_per_sample;
+	double msamples_per_s;
+	double p50_ns; // per block call
+	double p99_ns;
+	double p999_ns;
+	double max_ns;
+	bool finite; // output did not blow up
+};
+
+const char* typeName(uint64_t type) {
+	switch (type) {
+		case BUTTER: return "butterworth";
+		case CHEBY: return "chebyshev";
+		case NOTCH: return "notch";
+		default: return "elliptical";
+	}
+}
+
+std::vector<size_t> parseList(const std::string& text) {
+	std::vector<size_t> values;
+	size_t start = 0;
+	while (start < text.size()) {
+		size_t comma = text.find(',', start);
+		if (comma == std::string::npos) { comma = text.size(); }
+		values.push_back(std::strtoul(text.substr(start, comma - start).c_str(), nullptr, 10));
+		start = comma + 1;
+	}
+	return values;
+}
+
+bool parseArgs(int argc, char** argv, Options& options) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		const bool has_value = i + 1 < argc;
+		if (arg == "--rate" && has_value) { options.rate = std::atof(argv[++i]); }
+		else if (arg == "--samples" && has_value) { options.samples = std::strtoul(argv[++i], nullptr, 10); }
+		else if (arg == "--min-order" && has_value) { options.min_order = std::atoi(argv[++i]); }
+		else if (arg == "--max-order" && has_value) { options.max_order = std::atoi(argv[++i]); }
+		else if (arg == "--channels" && has_value) { options.channels = std::strtoul(argv[++i], nullptr, 10); }
+		else if (arg == "--blocks" && has_value) { options.blocks = parseList(argv[++i]); }
+		else if (arg == "--format" && has_value) { options.json = std::string(argv[++i]) == "json"; }
+		else {
+			fmt::print(stderr, "usage: {} [--rate Hz] [--samples n] [--min-order n] [--max-order n]"
+				" [--channels n] [--blocks a,b,c] [--format csv|json]\n", argv[0]);
+			return false;
+		}
+	}
+	return options.channels > 0 && !options.blocks.empty() && options.rate > 0;
+}
+
+double percentile(std::vector<double>& sorted, double fraction) {
+	const size_t index = std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()));
+	return sorted[index];
+}
+
+void processBlock(FilterBlock& filter, const double* in, double* out, size_t frames) {
+	if (frames == 1) {
+		filter.process(in, out);
+	} else {
+		filter.process(in, out, frames);
+	}
+}
+
+// Throughput comes from an uninterrupted pass; per-call latency from a second
+// pass that reads the clock around every call (and so includes its overhead).
+Result run(FilterBlock& filter, const std::vector<double>& input, std::vector<double>& output,
+	size_t channels, size_t block) {
+	using clock = std::chrono::steady_clock;
+	const size_t frames = input.size() / channels;
+	std::vector<double> call_ns;
+	call_ns.reserve(frames / block + 1);
+
+	// one untimed call to warm caches and branch predictors
+	processBlock(filter, input.data(), output.data(), std::min(frames, block));
+
+	const auto start = clock::now();
+	for (size_t f = 0; f < frames; f += block) {
+		processBlock(filter, input.data() + f * channels, output.data() + f * channels,
+			std::min(block, frames - f));
+	}
+	const double total_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+	for (size_t f = 0; f < frames; f += block) {
+		const auto t0 = clock::now();
+		processBlock(filter, input.data() + f * channels, output.data() + f * channels,
+			std::min(block, frames - f));
+		call_ns.push_back(std::chrono::duration<double, std::nano>(clock::now() - t0).count());
+	}
+
+	Result result{};
+	const double samples = static_cast<double>(frames * channels);
+	result.ns_per_sample = total_ns / samples;
+	result.msamples_per_s = samples / total_ns * 1e3;
+	std::sort(call_ns.begin(), call_ns.end());
+	result.p50_ns = percentile(call_ns, 0.5);
+	result.p99_ns = percentile(call_ns, 0.99);
+	result.p999_ns = percentile(call_ns, 0.999);
+	result.max_ns = call_ns.back();
+	result.finite = std::all_of(output.end() - channels, output.end(),
+		[](double v) { return std::isfinite(v); });
+	return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parseArgs(argc, argv, options)) { return 1; }
+
+	std::vector<double> input(options.samples * options.channels);
+	std::mt19937 generator(12345);
+	std::normal_distribution<double> noise(0.0, 1.0);
+	for (double& v : input) { v = noise(generator); }
+	std::vector<double> output(input.size());
+
+	if (!options.json) {
+		fmt::print("type,order,quantized,implementation,precision,channels,block,ns_per_sample,"
+			"msamples_per_s,p50_ns,p99_ns,p999_ns,max_ns,finite\n");
+	}
+
+	for (uint64_t type : {BUTTER, CHEBY, ELLIP}) {
+		for (int order = options.min_order; order <= options.max_order; order++) {
+			for (bool quantized : {false, true}) {
+				for (uint64_t implementation : {SECTIONS, DIRECT, FIXED_Q15, FIXED_Q31, SECTIONS_DF1, LATTICE, STATE_VARIABLE}) {
+					// quantizing always runs the direct form
+					if (quantized && implementation != DIRECT) { continue; }
+					for (uint64_t precision : {DOUBLE_PRECISION, SINGLE_PRECISION, MIXED_PRECISION}) {
+						// only the sections come in other precisions
+						if (precision != DOUBLE_PRECISION && (quantized || implementation != SECTIONS)) { continue; }
+
+						FilterSpec spec{};
+						spec.filter_type = type;
+						spec.filter_order = order;
+						spec.passband_ripple = 3;
+						spec.passband_edge = 60;
+						spec.stopband_ripple = 60;
+						spec.stopband_edge = 200;
+						spec.ripple_bw_norm = 0;
+						spec.predistort_enabled = true;
+						spec.quant_enabled = quantized;
+						spec.input_quan_factor = quantization_factor(12);
+						spec.coeff_quan_factor = quantization_factor(12);
+						spec.implementation = implementation;
+						spec.full_scale = 10;
+						spec.dt = 1.0 / options.rate;
+						spec.precision = precision;
+
+						const char* implem_name = quantized ? "direct-quantized" : implementationName(implementation);
+						for (size_t block : options.blocks) {
+							if (block == 0) { continue; }
+							std::unique_ptr<FilterBlock> filter = makeFilter(spec, options.channels);
+							Result r = run(*filter, input, output, options.channels, block);
+							if (options.json) {
+								fmt::print("{{\"type\":\"{}\",\"order\":{},\"quantized\":{},\"implementation\":\"{}\","
+									"\"precision\":\"{}\",\"channels\":{},\"block\":{},\"ns_per_sample\":{:.3f},"
+									"\"msamples_per_s\":{:.3f},\"p50_ns\":{:.1f},\"p99_ns\":{:.1f},\"p999_ns\":{:.1f},"
+									"\"max_ns\":{:.1f},\"finite\":{}}}\n",
+									typeName(type), order, quantized, implem_name, precisionName(precision),
+									options.channels, block, r.ns_per_sample, r.msamples_per_s, r.p50_ns, r.p99_ns,
+									r.p999_ns, r.max_ns, r.finite);
+							} else {
+								fmt::print("{},{},{},{},{},{},{},{:.3f},{:.3f},{:.1f},{:.1f},{:.1f},{:.1f},{}\n",
+									typeName(type), order, quantized ? 1 : 0, implem_name, precisionName(precision),
+									options.channels, block, r.ns_per_sample, r.msamples_per_s, r.p50_ns, r.p99_ns,
+									r.p999_ns, r.max_ns, r.finite ? 1 : 0);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	return 0;
+}
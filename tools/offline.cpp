@@ -0,0 +1,556 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* iir-filter-offline
+* Filters recordings after the fact with exactly the filter the plugin would
+* run for the same parameters and period. Inputs are memory-mapped, and the
+* output is filtered straight into a memory-mapped file. Every file is split
+* into groups of channels and the groups of all files are shared out over a
+* pool of threads.
+*
+* Raw input is frame-interleaved float64 (or float32 with --single), one
+* sample per channel per frame, after an optional header of --offset bytes.
+* With --dataset, inputs are HDF5 files and the named dataset (frames x
+* channels) is filtered. Output is always headerless frame-interleaved
+* float64, written to <input><suffix> or into --output-dir.
+*
+* --zero-phase filters each channel forwards and then backwards instead
+* (see ZeroPhaseFilter); the backward pass works in place on the output.
+*
+* --multirate runs the filter at a decimated rate as the plugin's multirate
+* mode does, with --decimation n to fix the factor and --hold to hold each
+* output rather than interpolate.
+*
+* --precision runs the second-order sections in single or mixed precision
+* (see sos-precision.hpp), or in whichever the design tolerates with auto.
+*
+* --coefficients file runs a filter saved by the plugin (or by
+* --save-coefficients) exactly as saved, without designing it; the period
+* comes from the file and any filter options are ignored. --save-coefficients
+* writes the filter used to a binary coefficient file, --save-sos to SOS
+* text (see coefficient-file.hpp); with either, the input files are optional.
+*
+* usage: iir-filter-offline (--period ns | --rate Hz | --coefficients file)
+*                           [filter options] [--precision p]
+*                           [--save-coefficients file]
+*                           [--save-sos file] [--channels n] [--single]
+*                           [--offset bytes] [--dataset name]
+*                           [--output-dir dir] [--suffix text] [--threads n]
+*                           [--zero-phase] file...
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fmt/core.h>
+#include "../dsp/coefficient-file.hpp"
+#include "../dsp/design-cache.hpp"
+#include "../dsp/filter-design.hpp"
+#include "../dsp/numeric-health.hpp"
+#include "../dsp/order-search.hpp"
+#include "../dsp/zero-phase.hpp"
+
+#ifdef IIR_FILTER_HAVE_HDF5
+#include <hdf5.h>
+#endif
+
+namespace {
+
+constexpr size_t GROUP_CHANNELS = 8; // channels per task, one cache line of float64
+constexpr size_t CHUNK_FRAMES = 4096; // frames gathered per kernel call
+
+struct Options {
+	FilterSpec spec{};
+	int64_t period = 0; // ns
+	size_t channels = 1;
+	bool single = false;
+	bool zero_phase = false;
+	size_t offset = 0;
+	std::string dataset;
+	std::string output_dir;
+	std::string suffix = ".filtered";
+	std::string coefficients; // load the filter from here rather than design it
+	std::string save_path; // write the filter used here
+	coefficient_format_t save_format = COEFFICIENTS_BINARY;
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::string> inputs;
+};
+
+// An mmap() region, unmapped on destruction.
+class Mapping {
+	public:
+		Mapping() = default;
+		Mapping(const Mapping&) = delete;
+		Mapping& operator=(const Mapping&) = delete;
+		~Mapping() { if (address != nullptr) { munmap(address, length); } }
+
+		bool map(int fd, size_t bytes, int prot, int flags) {
+			if (bytes == 0) { return true; }
+			void* result = mmap(nullptr, bytes, prot, flags, fd, 0);
+			if (result == MAP_FAILED) { return false; }
+			address = result;
+			length = bytes;
+			return true;
+		}
+		char* data() const { return static_cast<char*>(address); }
+
+	private:
+		void* address = nullptr;
+		size_t length = 0;
+};
+
+struct Recording {
+	std::string input;
+	std::string output;
+	const char* samples = nullptr; // first sample of the first frame
+	bool single = false; // float32 rather than float64
+	size_t frames = 0;
+	size_t channels = 0;
+	Mapping in_map;
+	Mapping out_map;
+	std::vector<double> buffer; // holds the samples when they could not be mapped
+};
+
+struct Task {
+	Recording* recording;
+	size_t first_channel;
+	size_t num_channels;
+};
+
+const char* nextValue(int argc, char** argv, int& i) {
+	return i + 1 < argc ? argv[++i] : nullptr;
+}
+
+filter_t parseType(const std::string& name, bool& ok) {
+	if (name == "butterworth" || name == "butter") { return BUTTER; }
+	if (name == "chebyshev" || name == "cheby") { return CHEBY; }
+	if (name == "elliptical" || name == "ellip") { return ELLIP; }
+	if (name == "notch") { return NOTCH; }
+	ok = false;
+	return BUTTER;
+}
+
+implem_t parseImplementation(const std::string& name, bool& ok) {
+	if (name == "sections") { return SECTIONS; }
+	if (name == "direct") { return DIRECT; }
+	if (name == "q15") { return FIXED_Q15; }
+	if (name == "q31") { return FIXED_Q31; }
+	if (name == "df1") { return SECTIONS_DF1; }
+	if (name == "lattice") { return LATTICE; }
+	if (name == "state-variable") { return STATE_VARIABLE; }
+	ok = false;
+	return SECTIONS;
+}
+
+precision_t parsePrecision(const std::string& name, bool& ok) {
+	if (name == "double") { return DOUBLE_PRECISION; }
+	if (name == "single") { return SINGLE_PRECISION; }
+	if (name == "mixed") { return MIXED_PRECISION; }
+	if (name == "auto") { return AUTO_PRECISION; }
+	ok = false;
+	return DOUBLE_PRECISION;
+}
+
+// bits, as the plugin's quantizing factors take them, to the spec's 2^bits
+int parseQuantBits(const char* value, bool& ok) {
+	char* end;
+	const long bits = std::strtol(value, &end, 10);
+	if (end == value || *end != '\0' || bits < 1 || bits > 30) {
+		fmt::print(stderr, "quantizing bits must be 1 to 30, not {}\n", value);
+		ok = false;
+	}
+	return quantization_factor(bits);
+}
+
+void usage(const char* program) {
+	fmt::print(stderr, "usage: {} (--period ns | --rate Hz | --coefficients file) [--type butterworth|chebyshev|elliptical|notch]\n"
+		"  [--order n | --auto-order] [--passband-ripple dB] [--passband-edge Hz] [--stopband-ripple dB]\n"
+		"  [--stopband-edge Hz] [--norm n] [--no-predistort] [--quantize]\n"
+		"  [--input-quant bits] [--coeff-quant bits] [--implementation sections|direct|q15|q31|df1|lattice|state-variable]\n"
+		"  [--precision double|single|mixed|auto] [--full-scale amplitude] [--notch-frequency Hz] [--notch-harmonics n] [--notch-q q]\n"
+		"  [--multirate] [--decimation n] [--hold] [--save-coefficients file] [--save-sos file]\n"
+		"  [--channels n] [--single] [--offset bytes] [--dataset name] [--output-dir dir]\n"
+		"  [--suffix text] [--threads n] [--zero-phase] file...\n", program);
+}
+
+bool zeroPhaseAllowed(const Options& options) {
+	const FilterSpec& spec = options.spec;
+	const bool fixed = spec.implementation == FIXED_Q15 || spec.implementation == FIXED_Q31;
+	if (options.zero_phase && (spec.quant_enabled || fixed)) {
+		fmt::print(stderr, "--zero-phase runs the floating-point sections, drop --quantize or q15/q31\n");
+		return false;
+	}
+	if (options.zero_phase && spec.multirate) {
+		fmt::print(stderr, "--zero-phase runs at the full rate, drop --multirate\n");
+		return false;
+	}
+	if (options.zero_phase && spec.precision != DOUBLE_PRECISION) {
+		fmt::print(stderr, "--zero-phase runs in double precision, drop --precision\n");
+		return false;
+	}
+	return true;
+}
+
+bool parseArgs(int argc, char** argv, Options& options) {
+	// same defaults as the plugin
+	FilterSpec& spec = options.spec;
+	spec.filter_type = BUTTER;
+	spec.filter_order = 10;
+	spec.passband_ripple = 3;
+	spec.passband_edge = 60;
+	spec.stopband_ripple = 60;
+	spec.stopband_edge = 200;
+	spec.ripple_bw_norm = 0;
+	spec.predistort_enabled = true;
+	spec.quant_enabled = false;
+	spec.input_quan_factor = quantization_factor(12);
+	spec.coeff_quan_factor = quantization_factor(12);
+	spec.implementation = SECTIONS;
+	spec.full_scale = 10;
+	spec.notch_frequency = 60;
+	spec.notch_harmonics = 5;
+	spec.notch_q = 30;
+	spec.auto_order = false;
+	spec.multirate = false;
+	spec.decimation = 0;
+	spec.interpolate = true;
+	spec.precision = DOUBLE_PRECISION;
+
+	bool ok = true;
+	for (int i = 1; i < argc && ok; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 2, "--") != 0) {
+			options.inputs.push_back(arg);
+			continue;
+		}
+		if (arg == "--single") { options.single = true; continue; }
+		if (arg == "--zero-phase") { options.zero_phase = true; continue; }
+		if (arg == "--quantize") { spec.quant_enabled = true; continue; }
+		if (arg == "--no-predistort") { spec.predistort_enabled = false; continue; }
+		if (arg == "--auto-order") { spec.auto_order = true; continue; }
+		if (arg == "--multirate") { spec.multirate = true; continue; }
+		if (arg == "--hold") { spec.interpolate = false; continue; }
+
+		const char* value = nextValue(argc, argv, i);
+		if (value == nullptr) { ok = false; break; }
+		if (arg == "--period") { options.period = std::atoll(value); }
+		else if (arg == "--rate") { options.period = std::llround(1e9 / std::atof(value)); }
+		else if (arg == "--type") { spec.filter_type = parseType(value, ok); }
+		else if (arg == "--order") { spec.filter_order = std::atoi(value); }
+		else if (arg == "--passband-ripple") { spec.passband_ripple = std::atof(value); }
+		else if (arg == "--passband-edge") { spec.passband_edge = std::atof(value); }
+		else if (arg == "--stopband-ripple") { spec.stopband_ripple = std::atof(value); }
+		else if (arg == "--stopband-edge") { spec.stopband_edge = std::atof(value); }
+		else if (arg == "--norm") { spec.ripple_bw_norm = std::atoi(value); }
+		else if (arg == "--input-quant") { spec.input_quan_factor = parseQuantBits(value, ok); }
+		else if (arg == "--coeff-quant") { spec.coeff_quan_factor = parseQuantBits(value, ok); }
+		else if (arg == "--implementation") { spec.implementation = parseImplementation(value, ok); }
+		else if (arg == "--precision") { spec.precision = parsePrecision(value, ok); }
+		else if (arg == "--full-scale") { spec.full_scale = std::atof(value); }
+		else if (arg == "--notch-frequency") { spec.notch_frequency = std::atof(value); }
+		else if (arg == "--notch-harmonics") { spec.notch_harmonics = std::atoi(value); }
+		else if (arg == "--notch-q") { spec.notch_q = std::atof(value); }
+		else if (arg == "--decimation") {
+			spec.multirate = true;
+			spec.decimation = std::clamp(std::atoi(value), 0, static_cast<int>(MAX_DECIMATION));
+		}
+		else if (arg == "--channels") { options.channels = std::strtoul(value, nullptr, 10); }
+		else if (arg == "--offset") { options.offset = std::strtoul(value, nullptr, 10); }
+		else if (arg == "--dataset") { options.dataset = value; }
+		else if (arg == "--output-dir") { options.output_dir = value; }
+		else if (arg == "--suffix") { options.suffix = value; }
+		else if (arg == "--threads") { options.threads = std::max(1, std::atoi(value)); }
+		else if (arg == "--coefficients") { options.coefficients = value; }
+		else if (arg == "--save-coefficients") {
+			options.save_path = value;
+			options.save_format = COEFFICIENTS_BINARY;
+		}
+		else if (arg == "--save-sos") {
+			options.save_path = value;
+			options.save_format = COEFFICIENTS_SOS_TEXT;
+		}
+		else { ok = false; }
+	}
+	ok = ok && (options.period > 0 || !options.coefficients.empty()) && options.channels > 0
+		&& (!options.inputs.empty() || !options.save_path.empty());
+	if (ok && !zeroPhaseAllowed(options)) { return false; }
+	if (!ok) {
+		usage(argv[0]);
+		return false;
+	}
+	// computed as the plugin does, so the designs match to the last bit
+	spec.dt = options.period * 1e-9; // s
+	return true;
+}
+
+std::string outputPath(const Options& options, const std::string& input) {
+	if (options.output_dir.empty()) { return input + options.suffix; }
+	const size_t slash = input.find_last_of('/');
+	const std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+	return options.output_dir + "/" + name + options.suffix;
+}
+
+bool openRaw(const Options& options, Recording& recording) {
+	const int fd = open(recording.input.c_str(), O_RDONLY);
+	if (fd < 0) {
+		fmt::print(stderr, "{}: {}\n", recording.input, std::strerror(errno));
+		return false;
+	}
+	struct stat info{};
+	fstat(fd, &info);
+	const size_t size = static_cast<size_t>(info.st_size);
+	const bool mapped = recording.in_map.map(fd, size, PROT_READ, MAP_PRIVATE);
+	close(fd);
+	if (!mapped) {
+		fmt::print(stderr, "{}: cannot map: {}\n", recording.input, std::strerror(errno));
+		return false;
+	}
+	const size_t frame_bytes = options.channels * (options.single ? sizeof(float) : sizeof(double));
+	const size_t payload = size > options.offset ? size - options.offset : 0;
+	if (payload % frame_bytes != 0) {
+		fmt::print(stderr, "{}: warning: ignoring {} trailing bytes\n", recording.input, payload % frame_bytes);
+	}
+	if (size > 0) { madvise(recording.in_map.data(), size, MADV_SEQUENTIAL); }
+	recording.samples = recording.in_map.data() + std::min(options.offset, size);
+	recording.single = options.single;
+	recording.channels = options.channels;
+	recording.frames = payload / frame_bytes;
+	return true;
+}
+
+#ifdef IIR_FILTER_HAVE_HDF5
+// Contiguous, unfiltered little-endian float datasets are mapped straight from
+// the file; anything else (chunked, compressed, other types) is read through
+// the library into memory.
+bool openHdf5(const Options& options, Recording& recording) {
+	bool ok = false;
+	hid_t file = H5Fopen(recording.input.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+	hid_t dataset = file < 0 ? -1 : H5Dopen2(file, options.dataset.c_str(), H5P_DEFAULT);
+	if (dataset >= 0) {
+		hid_t space = H5Dget_space(dataset);
+		hid_t type = H5Dget_type(dataset);
+		hid_t create = H5Dget_create_plist(dataset);
+		hsize_t dims[2] = {0, 1};
+		const int rank = H5Sget_simple_extent_ndims(space);
+		if (rank == 1 || rank == 2) {
+			H5Sget_simple_extent_dims(space, dims, nullptr);
+			recording.frames = dims[0];
+			recording.channels = dims[1];
+			ok = true;
+		} else {
+			fmt::print(stderr, "{}: {} must be frames x channels\n", recording.input, options.dataset);
+		}
+
+		const bool f64 = H5Tequal(type, H5T_IEEE_F64LE) > 0;
+		const bool f32 = H5Tequal(type, H5T_IEEE_F32LE) > 0;
+		const haddr_t address = H5Dget_offset(dataset);
+		const bool mappable = ok && (f64 || f32) && H5Pget_layout(create) == H5D_CONTIGUOUS
+			&& H5Pget_nfilters(create) == 0 && address != HADDR_UNDEF;
+		if (mappable) {
+			const int fd = open(recording.input.c_str(), O_RDONLY);
+			struct stat info{};
+			const bool mapped = fd >= 0 && fstat(fd, &info) == 0
+				&& recording.in_map.map(fd, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE);
+			if (fd >= 0) { close(fd); }
+			if (mapped) {
+				recording.samples = recording.in_map.data() + address;
+				recording.single = f32;
+			}
+		}
+		if (ok && recording.samples == nullptr) {
+			recording.buffer.resize(recording.frames * recording.channels);
+			ok = H5Dread(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+				recording.buffer.data()) >= 0;
+			recording.samples = reinterpret_cast<const char*>(recording.buffer.data());
+			recording.single = false;
+		}
+		H5Pclose(create);
+		H5Tclose(type);
+		H5Sclose(space);
+		H5Dclose(dataset);
+	} else {
+		fmt::print(stderr, "{}: cannot open dataset {}\n", recording.input, options.dataset);
+	}
+	if (file >= 0) { H5Fclose(file); }
+	return ok;
+}
+#endif
+
+bool openOutput(Recording& recording) {
+	const size_t bytes = recording.frames * recording.channels * sizeof(double);
+	const int fd = open(recording.output.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fmt::print(stderr, "{}: {}\n", recording.output, std::strerror(errno));
+		return false;
+	}
+	bool ok = ftruncate(fd, static_cast<off_t>(bytes)) == 0
+		&& recording.out_map.map(fd, bytes, PROT_READ | PROT_WRITE, MAP_SHARED);
+	if (!ok) { fmt::print(stderr, "{}: {}\n", recording.output, std::strerror(errno)); }
+	close(fd);
+	return ok;
+}
+
+// Runs one group of channels through its own filter, CHUNK_FRAMES frames at a
+// time: gather the group's samples, filter them in place, scatter them into
+// the output mapping. For zero phase the samples are only copied across, and
+// each channel is then filtered both ways where it lies in the output.
+void runTask(const Task& task, const std::shared_ptr<const FilterDesign>& design,
+	const Options& options) {
+	Recording& recording = *task.recording;
+	std::unique_ptr<FilterBlock> filter;
+	if (!options.zero_phase) { filter = makeFilter(design, options.spec, task.num_channels); }
+	std::vector<double> chunk(CHUNK_FRAMES * task.num_channels);
+	const size_t sample_bytes = recording.single ? sizeof(float) : sizeof(double);
+	const size_t frame_bytes = recording.channels * sample_bytes;
+	double* out = reinterpret_cast<double*>(recording.out_map.data());
+
+	for (size_t first = 0; first < recording.frames; first += CHUNK_FRAMES) {
+		const size_t frames = std::min(CHUNK_FRAMES, recording.frames - first);
+		for (size_t f = 0; f < frames; f++) {
+			const char* src = recording.samples + (first + f) * frame_bytes + task.first_channel * sample_bytes;
+			double* dst = chunk.data() + f * task.num_channels;
+			if (recording.single) {
+				for (size_t c = 0; c < task.num_channels; c++) {
+					float value;
+					std::memcpy(&value, src + c * sizeof(float), sizeof(float));
+					dst[c] = value;
+				}
+			} else {
+				std::memcpy(dst, src, task.num_channels * sizeof(double));
+			}
+		}
+		if (filter != nullptr) { filter->process(chunk.data(), chunk.data(), frames); }
+		for (size_t f = 0; f < frames; f++) {
+			std::memcpy(out + (first + f) * recording.channels + task.first_channel,
+				chunk.data() + f * task.num_channels, task.num_channels * sizeof(double));
+		}
+	}
+
+	if (options.zero_phase) {
+		ZeroPhaseFilter zero_phase(design->sections);
+		for (size_t c = task.first_channel; c < task.first_channel + task.num_channels; c++) {
+			zero_phase.process(out + c, out + c, recording.frames, recording.channels);
+		}
+	}
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parseArgs(argc, argv, options)) { return 1; }
+#ifndef IIR_FILTER_HAVE_HDF5
+	if (!options.dataset.empty()) {
+		fmt::print(stderr, "built without HDF5 support, --dataset is unavailable\n");
+		return 1;
+	}
+#endif
+
+	std::vector<std::unique_ptr<Recording>> recordings;
+	for (const std::string& input : options.inputs) {
+		auto recording = std::make_unique<Recording>();
+		recording->input = input;
+		recording->output = outputPath(options, input);
+#ifdef IIR_FILTER_HAVE_HDF5
+		const bool opened = options.dataset.empty() ? openRaw(options, *recording) : openHdf5(options, *recording);
+#else
+		const bool opened = openRaw(options, *recording);
+#endif
+		if (!opened || !openOutput(*recording)) { return 1; }
+		recordings.push_back(std::move(recording));
+	}
+
+	// one design for every task, exactly as the plugin's design thread makes it
+	std::shared_ptr<const FilterDesign> design;
+	if (!options.coefficients.empty()) {
+		CoefficientFile file;
+		std::string error;
+		if (!loadCoefficients(options.coefficients, file, error)) {
+			fmt::print(stderr, "{}\n", error);
+			return 1;
+		}
+		if (options.period > 0 && file.spec.dt != options.spec.dt) {
+			fmt::print(stderr, "{}: designed for a period of {} ns, not {} ns\n", options.coefficients,
+				file.spec.dt * 1e9, options.period);
+			return 1;
+		}
+		options.spec = file.spec;
+		design = file.design;
+		if (!zeroPhaseAllowed(options)) { return 1; }
+	} else if (options.spec.auto_order) {
+		OrderSearchResult search = findMinimumOrder(options.spec, options.threads);
+		const char* names[] = {"butterworth", "chebyshev", "elliptical", "notch"};
+		fmt::print(stderr, "auto order: {} order {}{}\n", names[search.spec.filter_type],
+			search.spec.filter_order, search.meets_spec ? "" : " (closest; spec not met)");
+		options.spec = search.spec;
+		design = search.design;
+	} else {
+		// through the same on-disk store as the plugin
+		DesignStore store(DesignStore::defaultDirectory());
+		design = DesignCache(1, &store).get(options.spec);
+	}
+	if (!options.save_path.empty()) {
+		CoefficientFile file;
+		file.spec = canonicalSpec(options.spec);
+		file.design = design;
+		std::string error;
+		if (!saveCoefficients(options.save_path, file, options.save_format, error)) {
+			fmt::print(stderr, "{}\n", error);
+			return 1;
+		}
+	}
+
+	std::vector<Task> tasks;
+	for (const auto& recording : recordings) {
+		if (recording->frames == 0) { continue; }
+		for (size_t c = 0; c < recording->channels; c += GROUP_CHANNELS) {
+			tasks.push_back({recording.get(), c, std::min(GROUP_CHANNELS, recording->channels - c)});
+		}
+	}
+
+	std::atomic<size_t> next{0};
+	auto worker = [&]() {
+		const ScopedFlushToZero flush_to_zero; // as on the plugin's real-time thread
+		for (size_t i = next++; i < tasks.size(); i = next++) {
+			runTask(tasks[i], design, options);
+		}
+	};
+	std::vector<std::thread> pool;
+	const size_t num_threads = std::min<size_t>(options.threads, tasks.size());
+	for (size_t i = 1; i < num_threads; i++) { pool.emplace_back(worker); }
+	worker();
+	for (std::thread& thread : pool) { thread.join(); }
+
+	for (const auto& recording : recordings) {
+		fmt::print("{} -> {} ({} frames x {} channels)\n", recording->input, recording->output,
+			recording->frames, recording->channels);
+	}
+	return 0;
+}
@@ -0,0 +1,396 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* iir-filter-replay
+* Runs the plugin's own IIRfilterComponent, tick by tick, without RTXI: the
+* component is built against the stand-in headers in tools/replay/rtxi, the
+* input stream is fed to its input ports and execute() is called once per
+* frame, with parameter changes and state changes (INIT, MODIFY, PERIOD,
+* PAUSE, UNPAUSE) applied at the ticks a script names. Before every tick the
+* harness waits for the design thread to settle, so a filter is always
+* adopted on the same tick and the output is reproducible to the last bit.
+*
+* The output can be recorded as a golden file and compared against one
+* within a tolerance; every execute() is timed and summarized per state.
+* --stream taps the component's inputs and outputs to a file through its
+* own streaming sink (stream-sink.hpp), as the panel's button does.
+*
+* The script has one command per line, in tick order:
+*   <tick> set <PARAMETER> <value>   e.g. 0 set PASSBAND_EDGE 300
+*   <tick> state init|modify|pause|unpause|exec
+*   <tick> period <ns>               the period changes and PERIOD is run
+* Parameters are named as in the component's PARAMETER enum.
+*
+* usage: iir-filter-replay (--period ns | --rate Hz) [--script file]
+*                          [--channels n] (--input file | --frames n)
+*                          [--golden file] [--tolerance x] [--record file]
+*                          [--timing file] [--timeout ms] [--stream file]
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fmt/core.h>
+#include "../component.hpp"
+
+namespace {
+
+struct Options {
+	int64_t period = 0; // ns
+	size_t channels = 1;
+	std::string script;
+	std::string input; // frame-interleaved float64
+	size_t frames = 0; // of seeded noise, without an input
+	std::string golden;
+	double tolerance = 1e-12; // relative, and absolute below 1
+	std::string record;
+	std::string timing;
+	int64_t timeout_ms = 30000; // for the design thread to settle
+	std::string stream; // the component's own tap of inputs and outputs
+};
+
+struct Command {
+	size_t tick;
+	enum { SET, STATE, PERIOD } kind;
+	Widgets::Variable::Id parameter;
+	std::string value;
+	RT::State::state_t state;
+	int64_t period;
+};
+
+struct Tick {
+	RT::State::state_t state; // on entry to execute()
+	double ns;
+};
+
+#define PARAMETER_NAME(parameter) {#parameter, parameter}
+const std::pair<const char*, Widgets::Variable::Id> PARAMETER_NAMES[] = {
+	PARAMETER_NAME(FILTER_ORDER),
+	PARAMETER_NAME(PASSBAND_RIPPLE),
+	PARAMETER_NAME(PASSBAND_EDGE),
+	PARAMETER_NAME(STOPBAND_RIPPLE),
+	PARAMETER_NAME(STOPBAND_EDGE),
+	PARAMETER_NAME(INPUT_QUANTIZING_FACTOR),
+	PARAMETER_NAME(COEFF_QUANTIZING_FACTOR),
+	PARAMETER_NAME(FILTER_TYPE),
+	PARAMETER_NAME(CHEBYSHEV_NORM_TYPE),
+	PARAMETER_NAME(PREDISTORT),
+	PARAMETER_NAME(QUANTIZE),
+	PARAMETER_NAME(IMPLEMENTATION),
+	PARAMETER_NAME(FULL_SCALE),
+	PARAMETER_NAME(LIVE_RETUNE),
+	PARAMETER_NAME(CROSSFADE_TICKS),
+	PARAMETER_NAME(AUTO_ORDER),
+	PARAMETER_NAME(NOTCH_FREQUENCY),
+	PARAMETER_NAME(NOTCH_HARMONICS),
+	PARAMETER_NAME(NOTCH_Q),
+	PARAMETER_NAME(MULTIRATE),
+	PARAMETER_NAME(DECIMATION),
+	PARAMETER_NAME(INTERPOLATE),
+	PARAMETER_NAME(PRECISION),
+};
+#undef PARAMETER_NAME
+
+const std::pair<const char*, RT::State::state_t> STATE_NAMES[] = {
+	{"init", RT::State::INIT},
+	{"exec", RT::State::EXEC},
+	{"modify", RT::State::MODIFY},
+	{"period", RT::State::PERIOD},
+	{"pause", RT::State::PAUSE},
+	{"unpause", RT::State::UNPAUSE},
+};
+
+const char* stateName(RT::State::state_t state) {
+	for (const auto& entry : STATE_NAMES) {
+		if (entry.second == state) { return entry.first; }
+	}
+	return "undefined";
+}
+
+void usage(const char* program) {
+	fmt::print(stderr, "usage: {} (--period ns | --rate Hz) [--script file] [--channels n]\n"
+		"  (--input file | --frames n) [--golden file] [--tolerance x] [--record file]\n"
+		"  [--timing file] [--timeout ms] [--stream file]\n", program);
+}
+
+bool parseArgs(int argc, char** argv, Options& options) {
+	bool ok = true;
+	for (int i = 1; i < argc && ok; i++) {
+		const std::string arg = argv[i];
+		if (i + 1 >= argc) {
+			ok = false;
+			break;
+		}
+		const char* value = argv[++i];
+		if (arg == "--period") { options.period = std::atoll(value); }
+		else if (arg == "--rate") { options.period = std::llround(1e9 / std::atof(value)); }
+		else if (arg == "--channels") { options.channels = std::strtoul(value, nullptr, 10); }
+		else if (arg == "--script") { options.script = value; }
+		else if (arg == "--input") { options.input = value; }
+		else if (arg == "--frames") { options.frames = std::strtoul(value, nullptr, 10); }
+		else if (arg == "--golden") { options.golden = value; }
+		else if (arg == "--tolerance") { options.tolerance = std::atof(value); }
+		else if (arg == "--record") { options.record = value; }
+		else if (arg == "--timing") { options.timing = value; }
+		else if (arg == "--timeout") { options.timeout_ms = std::atoll(value); }
+		else if (arg == "--stream") { options.stream = value; }
+		else { ok = false; }
+	}
+	ok = ok && options.period > 0 && options.channels > 0 && (!options.input.empty() || options.frames > 0);
+	if (!ok) { usage(argv[0]); }
+	return ok;
+}
+
+bool readScript(const std::string& path, std::vector<Command>& commands) {
+	std::ifstream file(path);
+	if (!file) {
+		fmt::print(stderr, "{}: {}\n", path, std::strerror(errno));
+		return false;
+	}
+	std::string line;
+	for (size_t line_number = 1; std::getline(file, line); line_number++) {
+		std::istringstream words(line);
+		std::string first;
+		if (!(words >> first) || first[0] == '#') { continue; }
+		Command command{};
+		std::string keyword, name;
+		char* end;
+		command.tick = std::strtoul(first.c_str(), &end, 10);
+		bool ok = *end == '\0' && static_cast<bool>(words >> keyword);
+		if (ok && keyword == "set") {
+			command.kind = Command::SET;
+			ok = static_cast<bool>(words >> name >> command.value);
+			const auto* found = std::find_if(std::begin(PARAMETER_NAMES), std::end(PARAMETER_NAMES),
+				[&name](const auto& entry) { return name == entry.first; });
+			ok = ok && found != std::end(PARAMETER_NAMES);
+			if (ok) { command.parameter = found->second; }
+		} else if (ok && keyword == "state") {
+			command.kind = Command::STATE;
+			ok = static_cast<bool>(words >> name);
+			const auto* found = std::find_if(std::begin(STATE_NAMES), std::end(STATE_NAMES),
+				[&name](const auto& entry) { return name == entry.first; });
+			ok = ok && found != std::end(STATE_NAMES) && found->second != RT::State::PERIOD;
+			if (ok) { command.state = found->second; }
+		} else if (ok && keyword == "period") {
+			command.kind = Command::PERIOD;
+			ok = static_cast<bool>(words >> command.period) && command.period > 0;
+		} else {
+			ok = false;
+		}
+		if (ok && !commands.empty() && command.tick < commands.back().tick) {
+			fmt::print(stderr, "{}:{}: commands must be in tick order\n", path, line_number);
+			return false;
+		}
+		if (!ok) {
+			fmt::print(stderr, "{}:{}: cannot read \"{}\"\n", path, line_number, line);
+			return false;
+		}
+		commands.push_back(command);
+	}
+	return true;
+}
+
+bool readDoubles(const std::string& path, std::vector<double>& values) {
+	FILE* file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr) {
+		fmt::print(stderr, "{}: {}\n", path, std::strerror(errno));
+		return false;
+	}
+	double chunk[4096];
+	size_t count;
+	while ((count = std::fread(chunk, sizeof(double), 4096, file)) > 0) {
+		values.insert(values.end(), chunk, chunk + count);
+	}
+	std::fclose(file);
+	return true;
+}
+
+bool writeDoubles(const std::string& path, const std::vector<double>& values) {
+	FILE* file = std::fopen(path.c_str(), "wb");
+	bool ok = file != nullptr && std::fwrite(values.data(), sizeof(double), values.size(), file) == values.size();
+	ok = file != nullptr && std::fclose(file) == 0 && ok;
+	if (!ok) { fmt::print(stderr, "{}: {}\n", path, std::strerror(errno)); }
+	return ok;
+}
+
+void apply(const Command& command, IIRfilterComponent& component) {
+	switch (command.kind) {
+		case Command::SET:
+			switch (component.getVariables().at(command.parameter).vartype) {
+				case Widgets::Variable::INT_PARAMETER:
+					component.setValue<int64_t>(command.parameter, std::strtoll(command.value.c_str(), nullptr, 10));
+					break;
+				case Widgets::Variable::UINT_PARAMETER:
+					component.setValue<uint64_t>(command.parameter, std::strtoull(command.value.c_str(), nullptr, 10));
+					break;
+				default:
+					component.setValue<double>(command.parameter, std::atof(command.value.c_str()));
+					break;
+			}
+			break;
+		case Command::STATE:
+			component.setState(command.state);
+			break;
+		case Command::PERIOD:
+			RT::OS::setPeriod(command.period);
+			component.setState(RT::State::PERIOD);
+			break;
+	}
+}
+
+bool waitSettled(const IIRfilterComponent& component, int64_t timeout_ms) {
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	while (!component.designSettled()) {
+		if (std::chrono::steady_clock::now() > deadline) { return false; }
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+	return true;
+}
+
+// Within tolerance relative to the golden value, or absolute below 1.
+bool compareGolden(const Options& options, const std::vector<double>& output) {
+	std::vector<double> golden;
+	if (!readDoubles(options.golden, golden)) { return false; }
+	if (golden.size() != output.size()) {
+		fmt::print("golden: {} samples, replay produced {}: FAIL\n", golden.size(), output.size());
+		return false;
+	}
+	size_t failures = 0;
+	size_t first = 0;
+	double max_error = 0;
+	for (size_t i = 0; i < output.size(); i++) {
+		const double error = std::fabs(output[i] - golden[i]);
+		// a NaN on either side only matches a NaN
+		const bool same = error <= options.tolerance * std::max(1.0, std::fabs(golden[i]))
+			|| (std::isnan(output[i]) && std::isnan(golden[i]));
+		if (!same && failures++ == 0) { first = i; }
+		if (std::isfinite(error)) { max_error = std::max(max_error, error); }
+	}
+	fmt::print("golden: max error {:.3g}, tolerance {:.3g}: {}\n", max_error, options.tolerance,
+		failures == 0 ? "pass" : "FAIL");
+	if (failures > 0) {
+		fmt::print("golden: {} samples differ, first at tick {} channel {} ({:.17g}, golden {:.17g})\n",
+			failures, first / options.channels, first % options.channels, output[first], golden[first]);
+	}
+	return failures == 0;
+}
+
+double percentile(const std::vector<double>& sorted, double fraction) {
+	return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * static_cast<double>(sorted.size())))];
+}
+
+void printTiming(const std::vector<Tick>& ticks, int64_t period) {
+	for (const auto& entry : STATE_NAMES) {
+		std::vector<double> ns;
+		for (const Tick& tick : ticks) {
+			if (tick.state == entry.second) { ns.push_back(tick.ns); }
+		}
+		if (ns.empty()) { continue; }
+		std::sort(ns.begin(), ns.end());
+		const auto overruns = std::count_if(ns.begin(), ns.end(),
+			[period](double v) { return v > static_cast<double>(period); });
+		fmt::print("{}: {} ticks, min {:.2f} / p50 {:.2f} / p99 {:.2f} / max {:.2f} us, {} overruns\n",
+			entry.first, ns.size(), ns.front() * 1e-3, percentile(ns, 0.5) * 1e-3, percentile(ns, 0.99) * 1e-3,
+			ns.back() * 1e-3, overruns);
+	}
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parseArgs(argc, argv, options)) { return 1; }
+	std::vector<Command> commands;
+	if (!options.script.empty() && !readScript(options.script, commands)) { return 1; }
+
+	std::vector<double> input;
+	if (!options.input.empty()) {
+		if (!readDoubles(options.input, input)) { return 1; }
+	} else {
+		input.resize(options.frames * options.channels);
+		std::mt19937 generator(12345);
+		std::normal_distribution<double> noise(0.0, 1.0);
+		for (double& v : input) { v = noise(generator); }
+	}
+	const size_t frames = input.size() / options.channels;
+	std::vector<double> output(frames * options.channels);
+	std::vector<Tick> ticks(frames);
+
+	RT::OS::setPeriod(options.period);
+	IIRfilterComponent component(nullptr, options.channels);
+	std::string error;
+	if (!options.stream.empty() && !component.startStream(options.stream, error)) {
+		fmt::print(stderr, "{}\n", error);
+		return 1;
+	}
+	size_t next = 0;
+	for (size_t t = 0; t < frames; t++) {
+		for (; next < commands.size() && commands[next].tick == t; next++) { apply(commands[next], component); }
+		if (!waitSettled(component, options.timeout_ms)) {
+			fmt::print(stderr, "tick {}: the design thread did not settle within {} ms\n", t, options.timeout_ms);
+			return 1;
+		}
+		std::copy_n(input.begin() + static_cast<std::ptrdiff_t>(t * options.channels), options.channels,
+			component.getInputs().begin());
+		ticks[t].state = component.getState();
+		const auto start = std::chrono::steady_clock::now();
+		component.execute();
+		ticks[t].ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		std::copy(component.getOutputs().begin(), component.getOutputs().end(),
+			output.begin() + static_cast<std::ptrdiff_t>(t * options.channels));
+	}
+	if (next < commands.size()) {
+		fmt::print(stderr, "warning: {} commands after the last tick ({}) were not run\n", commands.size() - next, frames);
+	}
+
+	fmt::print("replayed {} ticks x {} channels at {} ns\n", frames, options.channels, RT::OS::getPeriod());
+	printTiming(ticks, RT::OS::getPeriod());
+	const HealthReport health = component.getHealth();
+	fmt::print("numerical faults: {} cleared, {} rebuilt\n", health.resets, health.rebuilds);
+	if (!options.stream.empty()) {
+		const StreamReport stream = component.getStream();
+		component.stopStream(); // writes out everything pushed
+		fmt::print("streamed to {}: {} ticks dropped{}\n", stream.path, stream.frames_dropped,
+			stream.error.empty() ? "" : ", " + stream.error);
+	}
+
+	if (!options.timing.empty()) {
+		FILE* file = std::fopen(options.timing.c_str(), "w");
+		if (file == nullptr) {
+			fmt::print(stderr, "{}: {}\n", options.timing, std::strerror(errno));
+			return 1;
+		}
+		fmt::print(file, "tick,state,ns\n");
+		for (size_t t = 0; t < frames; t++) { fmt::print(file, "{},{},{:.0f}\n", t, stateName(ticks[t].state), ticks[t].ns); }
+		std::fclose(file);
+	}
+	if (!options.record.empty() && !writeDoubles(options.record, output)) { return 1; }
+	if (!options.golden.empty() && !compareGolden(options, output)) { return 1; }
+	return 0;
+}
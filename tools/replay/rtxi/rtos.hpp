@@ -0,0 +1,50 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* Stand-in for RTXI's rtos.hpp, for iir-filter-replay (tools/replay.cpp):
+* the real-time period is whatever the harness last set, not a running
+* real-time thread's.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace RT {
+namespace State {
+enum state_t : int8_t {
+	INIT,
+	EXEC,
+	MODIFY,
+	PERIOD,
+	PAUSE,
+	UNPAUSE,
+	UNDEFINED=-1,
+};
+} // namespace State
+
+namespace OS {
+inline int64_t& period() {
+	static int64_t value = 1000000; // ns, RTXI's default of 1 kHz
+	return value;
+}
+inline int64_t getPeriod() { return period(); }
+inline void setPeriod(int64_t ns) { period() = ns; }
+} // namespace OS
+} // namespace RT
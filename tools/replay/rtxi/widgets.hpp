@@ -0,0 +1,119 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* Stand-in for the part of RTXI's widgets.hpp that IIRfilterComponent uses,
+* for iir-filter-replay (tools/replay.cpp). A Component keeps its parameter
+* values, its state and one sample per input and output channel in plain
+* members; the harness writes the inputs, sets parameters and states, calls
+* execute() and reads the outputs, which is all RTXI does to it. There is no
+* Panel and no Qt.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <variant>
+#include <vector>
+#include "rtos.hpp"
+
+namespace Event { class Manager; }
+
+namespace IO {
+enum flags_t {
+	INPUT=0,
+	OUTPUT,
+};
+
+struct channel_t {
+	std::string name;
+	std::string description;
+	flags_t flags;
+	size_t data_size = 1;
+};
+} // namespace IO
+
+namespace Widgets {
+namespace Variable {
+using Id = size_t;
+
+enum variable_t {
+	INT_PARAMETER=0,
+	DOUBLE_PARAMETER,
+	UINT_PARAMETER,
+	STATE,
+	COMMENT,
+	UNKNOWN,
+};
+
+struct Info {
+	Id id;
+	std::string name;
+	std::string description;
+	variable_t vartype;
+	std::variant<int64_t, double, uint64_t, std::string, RT::State::state_t> value;
+};
+} // namespace Variable
+
+class Plugin;
+
+class Component {
+	public:
+		Component(Plugin* /*host_plugin*/, const std::string& /*name*/, const std::vector<IO::channel_t>& channels,
+			const std::vector<Variable::Info>& variables)
+			: variables(variables)
+		{
+			for (const IO::channel_t& channel : channels) {
+				(channel.flags == IO::INPUT ? inputs : outputs).push_back(0.0);
+			}
+		}
+		virtual ~Component() = default;
+
+		virtual void execute() {}
+
+		RT::State::state_t getState() const { return state; }
+		void setState(RT::State::state_t new_state) { state = new_state; }
+
+		template<typename T>
+		T getValue(const size_t& var_id) { return std::get<T>(variables.at(var_id).value); }
+		template<typename T>
+		void setValue(const size_t& var_id, T value) { variables.at(var_id).value = value; }
+
+		double readinput(size_t channel) { return inputs.at(channel); }
+		void writeoutput(size_t channel, const double& value) { outputs.at(channel) = value; }
+
+		// the harness's side of the ports and parameters
+		std::vector<double>& getInputs() { return inputs; }
+		const std::vector<double>& getOutputs() const { return outputs; }
+		const std::vector<Variable::Info>& getVariables() const { return variables; }
+
+	private:
+		std::vector<Variable::Info> variables;
+		std::vector<double> inputs;
+		std::vector<double> outputs;
+		RT::State::state_t state = RT::State::INIT;
+};
+
+// only ever passed through to Component
+class Plugin {
+	public:
+		virtual ~Plugin() = default;
+};
+} // namespace Widgets
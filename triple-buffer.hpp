@@ -0,0 +1,57 @@
+/*
+Copyright (C) 2011 Georgia Institute of Technology
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+* TripleBuffer
+* Wait-free single producer / single consumer handoff of the latest value.
+* The producer never waits for the consumer and vice versa; intermediate
+* values are dropped if the producer outpaces the consumer.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+template<typename T>
+class TripleBuffer {
+	public:
+		// producer side: publish a new value, replacing any unconsumed one
+		void write(const T& value) {
+			buffers[back] = value;
+			back = middle.exchange(static_cast<uint8_t>(back | DIRTY), std::memory_order_acq_rel) & INDEX;
+		}
+
+		// consumer side: returns true and fills value if a new value was published
+		bool read(T& value) {
+			if ((middle.load(std::memory_order_relaxed) & DIRTY) == 0) { return false; }
+			front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+			value = buffers[front];
+			return true;
+		}
+
+	private:
+		static constexpr uint8_t INDEX = 0x3;
+		static constexpr uint8_t DIRTY = 0x4;
+
+		std::array<T, 3> buffers{};
+		uint8_t back = 0; // owned by the producer
+		uint8_t front = 1; // owned by the consumer
+		std::atomic<uint8_t> middle{2}; // shared, index plus dirty flag
+};
@@ -33,157 +33,25 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <rtxi/rtos.hpp>
 #include "widget.hpp"
 
-enum PARAMETER : Widgets::Variable::Id
-{
-	FILTER_ORDER=0,
-	PASSBAND_RIPPLE,
-	PASSBAND_EDGE,
-	STOPBAND_RIPPLE,
-	STOPBAND_EDGE,
-	INPUT_QUANTIZING_FACTOR,
-	COEFF_QUANTIZING_FACTOR,
-	FILTER_TYPE,
-	CHEBYSHEV_NORM_TYPE,
-	PREDISTORT,
-	QUANTIZE
-};
-
-inline std::vector<Widgets::Variable::Info> get_default_vars()
-{
-//set up parameters, calls for initialization, creation, update, and refresh of GUI
-	return {
-		{FILTER_ORDER,           "Filter Order", "Filter Order", Widgets::Variable::INT_PARAMETER, int64_t{10}},
-		{PASSBAND_RIPPLE,        "Passband Ripple (dB)", "Passband Ripple (dB)", Widgets::Variable::DOUBLE_PARAMETER, 3.0},
-		{PASSBAND_EDGE,          "Passband Edge (Hz)", "Passband Edge (Hz)", Widgets::Variable::DOUBLE_PARAMETER, 60.0},
-		{STOPBAND_RIPPLE,        "Stopband Ripple (dB)", "Stopband Ripple (dB)", Widgets::Variable::DOUBLE_PARAMETER, 60.0},
-		{STOPBAND_EDGE,          "Stopband Edge (Hz)", "Stopband Edge (Hz)", Widgets::Variable::DOUBLE_PARAMETER, 200.0},
-		{INPUT_QUANTIZING_FACTOR,"Input quantizing factor", "Bits eg. 10, 12, 16", Widgets::Variable::INT_PARAMETER, int64_t{4096}},
-		{COEFF_QUANTIZING_FACTOR,"Coefficients quantizing factor", "Bits eg. 10, 12, 16", Widgets::Variable::INT_PARAMETER, int64_t{4096}},
-		{FILTER_TYPE,		 "Type of filter to implement", "Butterworth, Chebyshev, Elliptical", Widgets::Variable::UINT_PARAMETER, uint64_t{0}},
-		{CHEBYSHEV_NORM_TYPE,	 "Chebyshev normalization type", "", Widgets::Variable::UINT_PARAMETER, uint64_t{0}},
-		{PREDISTORT,	 "Pre-Distort Signal", "", Widgets::Variable::UINT_PARAMETER, uint64_t{1}},
-		{QUANTIZE,	 "Use Quantization Mode", "", Widgets::Variable::UINT_PARAMETER, uint64_t{0}}
-	};
-}
-
-inline std::vector<IO::channel_t> get_default_channels()
-{
-//set up inputs/outputs, calls for initialization, creation, update, and refresh of GUI
-	return {
-		{ "Input", "Input to Filter", IO::INPUT, },
-		{ "Output", "Output of Filter", IO::OUTPUT }
-	};
-}
-
 IIRfilter::IIRfilter(QMainWindow* main_window, Event::Manager* ev_manager) 
 	: Widgets::Panel(std::string("IIR Filter"), main_window, ev_manager) 
 {
 	setWhatsThis(
-	"<p><b>IIR Filter:</b><br>This plugin computes filter coefficients for three types of IIR filters. "
+	"<p><b>IIR Filter:</b><br>This plugin computes filter coefficients for four types of IIR filters. "
 	"They require the following parameters: <br><br>"
 	"Butterworth: passband edge <br>"
 	"Chebyshev: passband ripple, passband edge, ripple bw_norm <br>"
-	"Elliptical: passband ripple, stopband ripple, passband edge, stopband edge <br><br>"
-	"Since this plug-in computes new filter coefficients whenever you change the parameters, you should not"
-	"change any settings during real-time.</p>");
+	"Elliptical: passband ripple, stopband ripple, passband edge, stopband edge <br>"
+	"Harmonic notch: notch frequency, notch harmonics, notch Q <br><br>"
+	"New coefficients are computed off the real-time thread whenever you change the parameters. "
+	"By default the filter pauses until you unpause it; with \"Retune without pausing\" checked it "
+	"keeps filtering and crossfades to the new filter over the crossfade ticks.</p>");
 	
-	Widgets::Panel::createGUI(get_default_vars(), {FILTER_TYPE, PREDISTORT, QUANTIZE, CHEBYSHEV_NORM_TYPE});
+	Widgets::Panel::createGUI(get_default_vars(), {FILTER_TYPE, PREDISTORT, QUANTIZE, CHEBYSHEV_NORM_TYPE, IMPLEMENTATION, LIVE_RETUNE, AUTO_ORDER, MULTIRATE, INTERPOLATE, PRECISION});
 	customizeGUI();
 	QTimer::singleShot(0, this, SLOT(resizeMe()));
 }
 
-IIRfilterComponent::IIRfilterComponent(Widgets::Plugin* host_plugin) 
-	: Widgets::Component(host_plugin, "IIR Filter", get_default_channels(), get_default_vars())
-{}
-				
-//execute, the code block that actually does the signal processing
-void IIRfilterComponent::execute() {
-	switch (this->getState()) {
-		case RT::State::EXEC:
-			writeoutput(0, filter_implem->ProcessSample(readinput(0)));
-			break;
-		case RT::State::INIT:
-      filter_order = getValue<int64_t>(FILTER_ORDER);
-			passband_ripple = getValue<double>(PASSBAND_RIPPLE);
-			passband_edge = getValue<double>(PASSBAND_EDGE);
-			stopband_ripple = getValue<double>(STOPBAND_RIPPLE);
-			stopband_edge = getValue<double>(STOPBAND_EDGE);
-			stopband_edge *= TWO_PI;
-			filter_type = static_cast<filter_t>(getValue<uint64_t>(FILTER_TYPE));
-			input_quan_factor = 2 ^ getValue<int64_t>(INPUT_QUANTIZING_FACTOR); // quantize input to 12 bits
-			coeff_quan_factor = 2 ^ getValue<int64_t>(COEFF_QUANTIZING_FACTOR); // quantize filter coefficients to 12 bits
-			ripple_bw_norm = getValue<uint64_t>(CHEBYSHEV_NORM_TYPE);
-			predistort_enabled = getValue<uint64_t>(PREDISTORT) == 1;
-			quant_enabled = getValue<uint64_t>(QUANTIZE) == 1;
-			makeFilter();
-			writeoutput(0, filter_implem->ProcessSample(readinput(0)));
-      this->setState(RT::State::EXEC);
-		case RT::State::MODIFY:
-			filter_order = getValue<int64_t>(FILTER_ORDER);
-			passband_ripple = getValue<double>(PASSBAND_RIPPLE);
-			passband_edge = getValue<double>(PASSBAND_EDGE);
-			stopband_ripple = getValue<double>(STOPBAND_RIPPLE);
-			stopband_edge = getValue<double>(STOPBAND_EDGE);
-			stopband_edge *= TWO_PI;
-			filter_type = static_cast<filter_t>(getValue<uint64_t>(FILTER_TYPE));
-			input_quan_factor = 2 ^ getValue<int64_t>(INPUT_QUANTIZING_FACTOR); // quantize input to 12 bits
-			coeff_quan_factor = 2 ^ getValue<int64_t>(COEFF_QUANTIZING_FACTOR); // quantize filter coefficients to 12 bits
-			ripple_bw_norm = getValue<uint64_t>(CHEBYSHEV_NORM_TYPE);
-			predistort_enabled = getValue<uint64_t>(PREDISTORT) == 1;
-			quant_enabled = getValue<uint64_t>(QUANTIZE) == 1;
-			makeFilter();
-			writeoutput(0, filter_implem->ProcessSample(readinput(0)));
-			this->setState(RT::State::PAUSE);
-			break;
-		case RT::State::PAUSE:
-			writeoutput(0, 0); // stop command in case pause occurs in the middle of command
-			break;
-		case RT::State::UNPAUSE:
-			this->setState(RT::State::EXEC);
-			writeoutput(0,0);
-			break;
-		case RT::State::PERIOD:
-			dt = RT::OS::getPeriod() * 1e-9; // s
-			this->setState(RT::State::EXEC);
-			break;
-		default:
-			break;
-	}
-}
-
-std::vector<double> IIRfilterComponent::getNumeratorCoefficients()
-{
-	double* numerator_coeff = this->filter_design->GetNumerCoefficients();
-	int numer_count = this->filter_design->GetNumNumerCoeffs();
-	std::vector<double> result(numerator_coeff, numerator_coeff+numer_count);
-	return result;
-}
-
-std::vector<double> IIRfilterComponent::getDenominatorCoefficients()
-{
-	double* denominator_coeff = this->filter_design->GetDenomCoefficients();
-	int denomin_count = this->filter_design->GetNumDenomCoeffs();
-	std::vector<double> result(denominator_coeff, denominator_coeff+denomin_count);
-	return result;
-}
-
-// custom functions, as defined in the header file
-void IIRfilterComponent::initParameters() {
-	dt = RT::OS::getPeriod() * 1e-9; // s
-	filter_type = BUTTER;
-	filter_order = 10;
-	passband_ripple = 3;
-	passband_edge = 60;
-	stopband_ripple = 60;
-	stopband_edge = 200;
-	ripple_bw_norm = 0;
-	predistort_enabled = true;
-	quant_enabled = false;
-	input_quan_factor = 4096; // quantize input to 12 bits
-	coeff_quan_factor = 4096; // quantize filter coefficients to 12 bits
-	makeFilter();
-}
-
 void IIRfilter::updateFilterType(int index) {
 	if(index < 0) { return; }
 	int result = this->getHostPlugin()->setComponentParameter<uint64_t>(FILTER_TYPE, static_cast<uint64_t>(index));	
@@ -202,57 +70,51 @@ void IIRfilter::updateNormType(int index) {
 	this->update_state(RT::State::MODIFY);
 }
 
-void IIRfilterComponent::makeFilter() {
-	delete analog_filter;
-	switch (filter_type) {
-		case BUTTER:
-			analog_filter = new ButterworthTransFunc(filter_order);
-			analog_filter->LowpassDenorm(passband_edge);
-			break;
+void IIRfilter::updateImplemType(int index) {
+	if(index < 0) { return; }
+	int result = this->getHostPlugin()->setComponentParameter<uint64_t>(IMPLEMENTATION, static_cast<uint64_t>(index));
+	if(result < 0){
+		ERROR_MSG("IIRfilter::updateImplemType : Unable to change filter implementation"); 
+	}
+	this->update_state(RT::State::MODIFY);
+}
 
-		case CHEBY:
-			analog_filter = new ChebyshevTransFunc(filter_order, passband_ripple,
-			ripple_bw_norm);
-			analog_filter->LowpassDenorm(passband_edge);
-			break;
-	
-		case ELLIP:
-			int upper_summation_limit = 5;
-			analog_filter = new EllipticalTransFunc(filter_order, passband_ripple,
-			stopband_ripple, passband_edge, stopband_edge, upper_summation_limit);
-			break;
-	} // end of switch on window_shape
-	
-	if (predistort_enabled) analog_filter->FrequencyPrewarp(dt);
-	
-	delete filter_design;
-	filter_design = BilinearTransf(analog_filter, dt);
-
-	delete filter_implem;
-	if (quant_enabled) {
-		filter_implem = new DirectFormIir(filter_design->GetNumNumerCoeffs(),
-			filter_design->GetNumDenomCoeffs(),
-			filter_design->GetNumerCoefficients(),
-			filter_design->GetDenomCoefficients(), coeff_quan_factor,
-			input_quan_factor);
-	} else {
-		filter_implem = new UnquantDirectFormIir(
-			filter_design->GetNumNumerCoeffs(),
-			filter_design->GetNumDenomCoeffs(),
-			filter_design->GetNumerCoefficients(),
-			filter_design->GetDenomCoefficients());
+void IIRfilter::updatePrecisionType(int index) {
+	if(index < 0) { return; }
+	int result = this->getHostPlugin()->setComponentParameter<uint64_t>(PRECISION, static_cast<uint64_t>(index));
+	if(result < 0){
+		ERROR_MSG("IIRfilter::updatePrecisionType : Unable to change filter precision");
 	}
+	this->update_state(RT::State::MODIFY);
 }
 
 void IIRfilter::saveIIRData() {
 	QFileDialog* fd = new QFileDialog(this, "Save File As"/*, TRUE*/);
 	fd->setFileMode(QFileDialog::AnyFile);
 	fd->setViewMode(QFileDialog::Detail);
+	fd->setNameFilters(QStringList() << "Coefficients, binary (*.iir)" << "Coefficients, SOS text (*.sos)"
+		<< "Summary (*.txt)" << "All files (*)");
 	QString fileName;
 	auto* host_plugin = dynamic_cast<IIRfilterPlugin*>(this->getHostPlugin());
 	if (fd->exec() == QDialog::Accepted) {
 		QStringList files = fd->selectedFiles();
 		if (!files.isEmpty()) fileName = files.takeFirst();
+
+		// coefficient files can be loaded back; anything else gets the summary
+		if (fileName.endsWith(".iir") || fileName.endsWith(".sos")) {
+			const bool with_state = saveStateCheckBox->isChecked();
+			CoefficientFile file = host_plugin->getIIRfilterCoefficients(with_state);
+			const coefficient_format_t format = fileName.endsWith(".sos") ? COEFFICIENTS_SOS_TEXT : COEFFICIENTS_BINARY;
+			std::string error;
+			if (!saveCoefficients(fileName.toStdString(), file, format, error)) {
+				QMessageBox::information(this, "IIR filter: Save filter coefficients", QString::fromStdString(error));
+			} else if (with_state && file.state.empty()) {
+				QMessageBox::information(this, "IIR filter: Save filter coefficients",
+				"Saved without the filter state: it is only captured from a running\n"
+				"floating-point second-order section filter outside a crossfade.\n");
+			}
+			return;
+		}
 		
 		if (OpenFile(fileName)) {
 			// stream.setPrintableData(true);
@@ -279,6 +141,16 @@ void IIRfilter::saveIIRData() {
 						<< " stopband ripple=" << host_plugin->getComponentDoubleParameter(STOPBAND_RIPPLE)
 						<< " stopband edge=" << host_plugin->getComponentDoubleParameter(STOPBAND_EDGE);
 					break;
+
+				case 3:
+					stream << QString("HARMONIC NOTCH fundamental=") << host_plugin->getComponentDoubleParameter(NOTCH_FREQUENCY)
+						<< " harmonics=" << host_plugin->getComponentIntParameter(NOTCH_HARMONICS)
+						<< " Q=" << host_plugin->getComponentDoubleParameter(NOTCH_Q);
+					break;
+			}
+			if (host_plugin->getComponentUIntParameter(MULTIRATE) == 1) {
+				stream << " multirate decimation=" << host_plugin->getComponentIntParameter(DECIMATION)
+					<< " (0 = automatic; coefficients are for the decimated rate)";
 			}
 			stream << QString(" \n");
 		
@@ -305,6 +177,228 @@ void IIRfilter::saveIIRData() {
 	}
 }
 
+void IIRfilter::loadIIRData() {
+	QString fileName = QFileDialog::getOpenFileName(this, "Load IIR Coefficients", QString(),
+		"Coefficients (*.iir *.sos);;All files (*)");
+	if (fileName.isEmpty()) { return; }
+	CoefficientFile file;
+	std::string error;
+	if (!loadCoefficients(fileName.toStdString(), file, error)) {
+		QMessageBox::warning(this, "IIR filter: Load filter coefficients", QString::fromStdString(error));
+		return;
+	}
+	const FilterSpec spec = file.spec;
+	const int64_t input_bits = spec.quant_enabled ? quantization_bits(spec.input_quan_factor) : 0;
+	const int64_t coeff_bits = spec.quant_enabled ? quantization_bits(spec.coeff_quan_factor) : 0;
+	if (input_bits < 0 || coeff_bits < 0) {
+		QMessageBox::warning(this, "IIR filter: Load filter coefficients",
+		"The file quantizes to a factor that is not a power of two this plugin can set.\n");
+		return;
+	}
+	// the bilinear transform is for one period; the design only fits that one
+	if (spec.dt != RT::OS::getPeriod() * 1e-9) {
+		QMessageBox::warning(this, "IIR filter: Load filter coefficients",
+		QString("The file was designed for a period of %1 us and the system runs at %2 us.\n"
+			"The filter will be designed again from the saved parameters.\n")
+			.arg(spec.dt * 1e6).arg(RT::OS::getPeriod() * 1e-3));
+	}
+
+	auto* host_plugin = dynamic_cast<IIRfilterPlugin*>(this->getHostPlugin());
+	host_plugin->installIIRfilterCoefficients(std::move(file));
+
+	// Set every parameter the filter reads from the spec, so the request
+	// that follows is for the same spec and finds the installed design.
+	// Parameters the spec leaves at zero because the filter ignores them keep
+	// their current values.
+	host_plugin->setComponentParameter<uint64_t>(FILTER_TYPE, spec.filter_type);
+	if (spec.filter_type != NOTCH) {
+		host_plugin->setComponentParameter<int64_t>(FILTER_ORDER, spec.filter_order);
+		host_plugin->setComponentParameter<double>(PASSBAND_EDGE, spec.passband_edge);
+		host_plugin->setComponentParameter<uint64_t>(PREDISTORT, spec.predistort_enabled ? 1 : 0);
+	} else {
+		host_plugin->setComponentParameter<double>(NOTCH_FREQUENCY, spec.notch_frequency);
+		host_plugin->setComponentParameter<int64_t>(NOTCH_HARMONICS, spec.notch_harmonics);
+		host_plugin->setComponentParameter<double>(NOTCH_Q, spec.notch_q);
+	}
+	if (spec.filter_type == CHEBY || spec.filter_type == ELLIP) {
+		host_plugin->setComponentParameter<double>(PASSBAND_RIPPLE, spec.passband_ripple);
+	}
+	if (spec.filter_type == CHEBY) {
+		host_plugin->setComponentParameter<uint64_t>(CHEBYSHEV_NORM_TYPE, static_cast<uint64_t>(spec.ripple_bw_norm));
+	}
+	if (spec.filter_type == ELLIP) {
+		host_plugin->setComponentParameter<double>(STOPBAND_RIPPLE, spec.stopband_ripple);
+		host_plugin->setComponentParameter<double>(STOPBAND_EDGE, spec.stopband_edge);
+	}
+	host_plugin->setComponentParameter<uint64_t>(QUANTIZE, spec.quant_enabled ? 1 : 0);
+	if (spec.quant_enabled) {
+		host_plugin->setComponentParameter<int64_t>(INPUT_QUANTIZING_FACTOR, input_bits);
+		host_plugin->setComponentParameter<int64_t>(COEFF_QUANTIZING_FACTOR, coeff_bits);
+	} else {
+		host_plugin->setComponentParameter<uint64_t>(IMPLEMENTATION, spec.implementation);
+		host_plugin->setComponentParameter<uint64_t>(PRECISION, spec.precision);
+	}
+	if (spec.full_scale != 0) { host_plugin->setComponentParameter<double>(FULL_SCALE, spec.full_scale); }
+	host_plugin->setComponentParameter<uint64_t>(AUTO_ORDER, 0);
+	host_plugin->setComponentParameter<uint64_t>(MULTIRATE, spec.multirate ? 1 : 0);
+	if (spec.multirate) {
+		host_plugin->setComponentParameter<int64_t>(DECIMATION, spec.decimation);
+		host_plugin->setComponentParameter<uint64_t>(INTERPOLATE, spec.interpolate ? 1 : 0);
+	}
+
+	// the controls follow; the check boxes set the same values again
+	filterType->setCurrentIndex(static_cast<int>(spec.filter_type));
+	if (spec.filter_type == CHEBY) { normType->setCurrentIndex(spec.ripple_bw_norm); }
+	if (!spec.quant_enabled) {
+		implemType->setCurrentIndex(static_cast<int>(spec.implementation));
+		precisionType->setCurrentIndex(static_cast<int>(spec.precision));
+	}
+	if (spec.filter_type != NOTCH) { predistortCheckBox->setChecked(spec.predistort_enabled); }
+	quantizeCheckBox->setChecked(spec.quant_enabled);
+	autoOrderCheckBox->setChecked(false);
+	multirateCheckBox->setChecked(spec.multirate);
+	if (spec.multirate) { interpolateCheckBox->setChecked(spec.interpolate); }
+	this->refresh();
+	this->update_state(RT::State::MODIFY);
+}
+
+namespace {
+
+QString latencySummary(const char* state, const LatencyHistogram::Snapshot& s) {
+	if (s.count == 0) { return QString("%1: no ticks").arg(state); }
+	return QString("%1: %2 ticks, min %3 / p50 %4 / p99 %5 / max %6 us, %7 overruns")
+		.arg(state).arg(s.count)
+		.arg(s.min_ns * 1e-3, 0, 'f', 2).arg(s.p50_ns * 1e-3, 0, 'f', 2)
+		.arg(s.p99_ns * 1e-3, 0, 'f', 2).arg(s.max_ns * 1e-3, 0, 'f', 2)
+		.arg(s.overruns);
+}
+
+QString healthSummary(const HealthReport& h) {
+	return QString("Numerical faults: %1 cleared, %2 rebuilt; subnormals %3")
+		.arg(h.resets).arg(h.rebuilds).arg(h.flush_to_zero ? "flushed to zero" : "not flushed");
+}
+
+} // namespace
+
+void IIRfilter::refreshLatency() {
+	auto* host_plugin = dynamic_cast<IIRfilterPlugin*>(this->getHostPlugin());
+	LatencyReport report = host_plugin->getIIRfilterLatency();
+	latencyLabel->setText(latencySummary("EXEC", report.exec) + "\n"
+		+ latencySummary("MODIFY", report.modify) + "\n"
+		+ latencySummary("INIT", report.init) + "\n"
+		+ healthSummary(host_plugin->getIIRfilterHealth()));
+}
+
+void IIRfilter::refreshAutoOrder() {
+	auto* host_plugin = dynamic_cast<IIRfilterPlugin*>(this->getHostPlugin());
+	AutoOrderReport report = host_plugin->getIIRfilterAutoOrder();
+	if (!report.searched) {
+		autoOrderLabel->setText("Set by hand");
+		return;
+	}
+	const char* names[] = {"Butterworth", "Chebyshev", "Elliptical", "Harmonic notch"};
+	autoOrderLabel->setText(QString("%1, order %2%3").arg(names[report.filter_type])
+		.arg(report.filter_order).arg(report.meets_spec ? "" : " (closest; spec not met)"));
+}
+
+void IIRfilter::refreshTiming() {
+	auto* host_plugin = dynamic_cast<IIRfilterPlugin*>(this->getHostPlugin());
+	std::vector<ImplementationTiming> timing = host_plugin->getIIRfilterTiming();
+	if (timing.empty()) { return; }
+	QStringList lines;
+	for (const ImplementationTiming& t : timing) {
+		QString name = implemType->itemText(static_cast<int>(t.implementation));
+		if (t.implementation == SECTIONS) { name += QString(" (%1)").arg(precisionName(t.precision)); }
+		lines << QString("%1: %2 ns").arg(name).arg(t.ns_per_sample, 0, 'f', 1);
+	}
+	timingLabel->setText(lines.join("\n"));
+}
+
+void IIRfilter::refreshPrecision() {
+	auto* host_plugin = dynamic_cast<IIRfilterPlugin*>(this->getHostPlugin());
+	precisionLabel->setText(precisionType->itemText(static_cast<int>(host_plugin->getIIRfilterPrecision())));
+}
+
+void IIRfilter::refreshResponse() {
+	auto* host_plugin = dynamic_cast<IIRfilterPlugin*>(this->getHostPlugin());
+	std::shared_ptr<const FrequencyResponse> response = host_plugin->getIIRfilterResponse();
+	if (response != responsePlot->getResponse()) { responsePlot->setResponse(std::move(response)); }
+}
+
+void IIRfilter::updateResponseView(int index) {
+	if(index < 0) { return; }
+	responsePlot->setView(index);
+}
+
+void IIRfilter::toggleStream(bool on) {
+	auto* host_plugin = dynamic_cast<IIRfilterPlugin*>(this->getHostPlugin());
+	if (!on) {
+		host_plugin->stopIIRfilterStream();
+		refreshStream();
+		return;
+	}
+	QString fileName = QFileDialog::getSaveFileName(this, "Stream Inputs and Outputs To", QString(),
+		"Raw float64 (*.bin);;All files (*)");
+	std::string error;
+	if (fileName.isEmpty() || !host_plugin->startIIRfilterStream(fileName.toStdString(), error)) {
+		if (!error.empty()) {
+			QMessageBox::warning(this, "IIR filter: Stream to file", QString::fromStdString(error));
+		}
+		const QSignalBlocker blocker(streamButton);
+		streamButton->setChecked(false);
+	}
+	refreshStream();
+}
+
+void IIRfilter::refreshStream() {
+	auto* host_plugin = dynamic_cast<IIRfilterPlugin*>(this->getHostPlugin());
+	const StreamReport report = host_plugin->getIIRfilterStream();
+	if (!report.active) {
+		streamLabel->setText("Not streaming");
+		return;
+	}
+	QString text = QString("%1\n%2 ticks written, %3 dropped").arg(QString::fromStdString(report.path))
+		.arg(report.frames_written).arg(report.frames_dropped);
+	if (!report.error.empty()) { text += "\n" + QString::fromStdString(report.error); }
+	streamLabel->setText(text);
+}
+
+void IIRfilter::saveLatency() {
+	QFileDialog* fd = new QFileDialog(this, "Save File As");
+	fd->setFileMode(QFileDialog::AnyFile);
+	fd->setViewMode(QFileDialog::Detail);
+	QString fileName;
+	auto* host_plugin = dynamic_cast<IIRfilterPlugin*>(this->getHostPlugin());
+	if (fd->exec() == QDialog::Accepted) {
+		QStringList files = fd->selectedFiles();
+		if (!files.isEmpty()) fileName = files.takeFirst();
+
+		if (OpenFile(fileName)) {
+			LatencyReport report = host_plugin->getIIRfilterLatency();
+			const std::pair<const char*, const LatencyHistogram::Snapshot*> states[] = {
+				{"EXEC", &report.exec}, {"MODIFY", &report.modify}, {"INIT", &report.init}};
+			for (const auto& state : states) {
+				stream << latencySummary(state.first, *state.second) << "\n";
+			}
+			stream << healthSummary(host_plugin->getIIRfilterHealth()) << "\n";
+			// empty buckets are left out
+			stream << QString("state,low_ns,high_ns,count\n");
+			for (const auto& state : states) {
+				for (size_t i = 0; i < LatencyHistogram::NUM_BUCKETS; i++) {
+					if (state.second->buckets[i] == 0) { continue; }
+					stream << state.first << "," << LatencyHistogram::bucketLow(i) << ","
+						<< LatencyHistogram::bucketHigh(i) << "," << state.second->buckets[i] << "\n";
+				}
+			}
+			dataFile.close();
+		}
+		else {
+			QMessageBox::information(this, "IIR filter: Save latency histograms",
+			"There was an error writing to this file.\n");
+		}
+	}
+}
+
 bool IIRfilter::OpenFile(QString FName) {
 	dataFile.setFileName(FName);
 	if (dataFile.exists()) {
@@ -342,7 +436,16 @@ void IIRfilter::customizeGUI(void) {
 	//customGUILayout->addWidget(saveDataButton);
 	customLayout->addWidget(saveDataButton, 0);
 	QObject::connect(saveDataButton, SIGNAL(clicked()), this, SLOT(saveIIRData()));
-	saveDataButton->setToolTip("Save filter parameters and coefficients to a file");
+	saveDataButton->setToolTip("Save filter parameters and coefficients to a file: .iir (binary) and .sos (text) can be loaded back");
+
+	saveStateCheckBox = new QCheckBox("Save the filter state with the coefficients");
+	customLayout->addWidget(saveStateCheckBox, 0);
+	saveStateCheckBox->setToolTip("Load resumes from where the filter was rather than from rest");
+
+	QPushButton *loadDataButton = new QPushButton("Load IIR Coefficients");
+	customLayout->addWidget(loadDataButton, 0);
+	QObject::connect(loadDataButton, SIGNAL(clicked()), this, SLOT(loadIIRData()));
+	loadDataButton->setToolTip("Install saved coefficients as they are, without designing the filter again");
 
 	auto* topGroup = new QGroupBox("Filter Types");
 	QFormLayout *optionLayout = new QFormLayout(topGroup);
@@ -353,6 +456,7 @@ void IIRfilter::customizeGUI(void) {
 	filterType->insertItem(0, "Butterworth");
 	filterType->insertItem(1, "Chebyshev");
 	filterType->insertItem(2," Elliptical");
+	filterType->insertItem(NOTCH, "Harmonic notch");
 	optionLayout->addRow("IIR filter", filterType);
 	QObject::connect(filterType,SIGNAL(activated(int)), this, SLOT(updateFilterType(int)));
 	
@@ -363,20 +467,116 @@ void IIRfilter::customizeGUI(void) {
 	optionLayout->addRow("Chebyshev Normalize Type:", normType);
 	QObject::connect(normType,SIGNAL(activated(int)), this, SLOT(updateNormType(int)));
 	normType->setEnabled(false);
+
+	implemType = new QComboBox;
+	implemType->insertItem(SECTIONS, "Second-order sections");
+	implemType->insertItem(DIRECT, "Direct form");
+	implemType->insertItem(FIXED_Q15, "Fixed-point Q15");
+	implemType->insertItem(FIXED_Q31, "Fixed-point Q31");
+	implemType->insertItem(SECTIONS_DF1, "Direct form I sections");
+	implemType->insertItem(LATTICE, "Lattice-ladder");
+	implemType->insertItem(STATE_VARIABLE, "State variable");
+	implemType->setToolTip("How the filter is run. Quantization always uses the direct form");
+	optionLayout->addRow("Implementation:", implemType);
+	QObject::connect(implemType,SIGNAL(activated(int)), this, SLOT(updateImplemType(int)));
+
+	precisionType = new QComboBox;
+	precisionType->insertItem(DOUBLE_PRECISION, "Double");
+	precisionType->insertItem(SINGLE_PRECISION, "Single");
+	precisionType->insertItem(MIXED_PRECISION, "Mixed");
+	precisionType->insertItem(AUTO_PRECISION, "Automatic");
+	precisionType->setToolTip("Arithmetic of the second-order sections: single runs twice the channels per instruction, "
+		"mixed keeps only the state in single precision, automatic picks from how sensitive the poles are");
+	optionLayout->addRow("Precision:", precisionType);
+	QObject::connect(precisionType,SIGNAL(activated(int)), this, SLOT(updatePrecisionType(int)));
+
+	precisionLabel = new QLabel("Double");
+	precisionLabel->setToolTip("Precision the latest design runs in; other implementations than second-order sections run in double");
+	optionLayout->addRow("Running in:", precisionLabel);
+
+	timingLabel = new QLabel("Not measured yet");
+	timingLabel->setToolTip("Cost of each implementation for the latest design on this machine, per sample per channel");
+	optionLayout->addRow("Measured:", timingLabel);
+
+	autoOrderLabel = new QLabel("Set by hand");
+	autoOrderLabel->setToolTip("Type and order chosen when automatic order is on");
+	optionLayout->addRow("Chosen filter:", autoOrderLabel);
 	customLayout->insertWidget(0, topGroup);
 
 	auto* checkboxGroup = new QGroupBox("Finetunning");
 	QFormLayout *checkBoxLayout = new QFormLayout(checkboxGroup);
-	QCheckBox *predistortCheckBox = new QCheckBox;
+	predistortCheckBox = new QCheckBox;
 	checkBoxLayout->addRow("Predistort frequencies", predistortCheckBox);
-	QCheckBox *quantizeCheckBox = new QCheckBox;
+	quantizeCheckBox = new QCheckBox;
 	checkBoxLayout->addRow("Quantize input and coefficients", quantizeCheckBox);
 	QObject::connect(predistortCheckBox,SIGNAL(toggled(bool)),this,SLOT(togglePredistort(bool)));
 	QObject::connect(quantizeCheckBox,SIGNAL(toggled(bool)),this,SLOT(toggleQuantize(bool)));
 	predistortCheckBox->setToolTip("Predistort frequencies for bilinear transform");
 	quantizeCheckBox->setToolTip("Quantize input and coefficients");
+	QCheckBox *liveRetuneCheckBox = new QCheckBox;
+	checkBoxLayout->addRow("Retune without pausing", liveRetuneCheckBox);
+	QObject::connect(liveRetuneCheckBox,SIGNAL(toggled(bool)),this,SLOT(toggleLiveRetune(bool)));
+	liveRetuneCheckBox->setToolTip("Keep filtering through parameter changes, crossfading to the new filter");
+	autoOrderCheckBox = new QCheckBox;
+	checkBoxLayout->addRow("Choose type and order automatically", autoOrderCheckBox);
+	QObject::connect(autoOrderCheckBox,SIGNAL(toggled(bool)),this,SLOT(toggleAutoOrder(bool)));
+	autoOrderCheckBox->setToolTip("Use the cheapest filter that meets the edges and ripples, ignoring the type and order set here");
+	multirateCheckBox = new QCheckBox;
+	checkBoxLayout->addRow("Run at a decimated rate", multirateCheckBox);
+	QObject::connect(multirateCheckBox,SIGNAL(toggled(bool)),this,SLOT(toggleMultirate(bool)));
+	multirateCheckBox->setToolTip("Decimate, filter at the lower rate and come back up; for cutoffs far below Nyquist");
+	interpolateCheckBox = new QCheckBox;
+	interpolateCheckBox->setChecked(true);
+	checkBoxLayout->addRow("Interpolate back to every tick", interpolateCheckBox);
+	QObject::connect(interpolateCheckBox,SIGNAL(toggled(bool)),this,SLOT(toggleInterpolate(bool)));
+	interpolateCheckBox->setToolTip("Otherwise each multirate output is held until the next");
 	
 	customLayout->insertWidget(1, checkboxGroup);
+
+	auto* responseGroup = new QGroupBox("Response");
+	auto* responseLayout = new QVBoxLayout(responseGroup);
+	auto* responseView = new QComboBox;
+	responseView->insertItem(ResponsePlot::MAGNITUDE, "Magnitude");
+	responseView->insertItem(ResponsePlot::PHASE, "Phase");
+	responseView->insertItem(ResponsePlot::GROUP_DELAY, "Group delay");
+	responseView->setToolTip("Response of the latest design, before quantization");
+	responseLayout->addWidget(responseView);
+	QObject::connect(responseView,SIGNAL(activated(int)), this, SLOT(updateResponseView(int)));
+	responsePlot = new ResponsePlot;
+	responseLayout->addWidget(responsePlot);
+	customLayout->insertWidget(2, responseGroup);
+
+	auto* latencyGroup = new QGroupBox("Latency");
+	auto* latencyLayout = new QVBoxLayout(latencyGroup);
+	latencyLabel = new QLabel;
+	latencyLabel->setToolTip("Time spent in the real-time tick while running (EXEC) and on parameter changes (MODIFY, INIT)");
+	latencyLayout->addWidget(latencyLabel);
+	QPushButton *saveLatencyButton = new QPushButton("Save Latency Histograms");
+	latencyLayout->addWidget(saveLatencyButton);
+	QObject::connect(saveLatencyButton, SIGNAL(clicked()), this, SLOT(saveLatency()));
+	saveLatencyButton->setToolTip("Save the latency summaries and histogram buckets to a file");
+	customLayout->insertWidget(3, latencyGroup);
+
+	auto* streamGroup = new QGroupBox("Streaming");
+	auto* streamLayout = new QVBoxLayout(streamGroup);
+	streamButton = new QPushButton("Stream Inputs and Outputs to File");
+	streamButton->setCheckable(true);
+	streamButton->setToolTip("Write every tick's inputs then outputs as raw float64, without the Data Recorder; never stalls the real-time thread");
+	streamLayout->addWidget(streamButton);
+	QObject::connect(streamButton, SIGNAL(toggled(bool)), this, SLOT(toggleStream(bool)));
+	streamLabel = new QLabel("Not streaming");
+	streamLabel->setToolTip("Ticks written so far, and ticks dropped because the disk fell behind");
+	streamLayout->addWidget(streamLabel);
+	customLayout->insertWidget(4, streamGroup);
+
+	auto* refreshTimer = new QTimer(this);
+	QObject::connect(refreshTimer, SIGNAL(timeout()), this, SLOT(refreshLatency()));
+	QObject::connect(refreshTimer, SIGNAL(timeout()), this, SLOT(refreshAutoOrder()));
+	QObject::connect(refreshTimer, SIGNAL(timeout()), this, SLOT(refreshResponse()));
+	QObject::connect(refreshTimer, SIGNAL(timeout()), this, SLOT(refreshTiming()));
+	QObject::connect(refreshTimer, SIGNAL(timeout()), this, SLOT(refreshPrecision()));
+	QObject::connect(refreshTimer, SIGNAL(timeout()), this, SLOT(refreshStream()));
+	refreshTimer->start(500);
 	setLayout(customLayout);	
 }
 
@@ -390,6 +590,26 @@ void IIRfilter::toggleQuantize(bool on) {
 	this->getHostPlugin()->setComponentParameter(QUANTIZE, val);
 }
 
+void IIRfilter::toggleLiveRetune(bool on) {
+	uint64_t val = on ? 1 : 0;
+	this->getHostPlugin()->setComponentParameter(LIVE_RETUNE, val);
+}
+
+void IIRfilter::toggleAutoOrder(bool on) {
+	uint64_t val = on ? 1 : 0;
+	this->getHostPlugin()->setComponentParameter(AUTO_ORDER, val);
+}
+
+void IIRfilter::toggleMultirate(bool on) {
+	uint64_t val = on ? 1 : 0;
+	this->getHostPlugin()->setComponentParameter(MULTIRATE, val);
+}
+
+void IIRfilter::toggleInterpolate(bool on) {
+	uint64_t val = on ? 1 : 0;
+	this->getHostPlugin()->setComponentParameter(INTERPOLATE, val);
+}
+
 IIRfilterPlugin::IIRfilterPlugin(Event::Manager* ev_manager) : Widgets::Plugin(ev_manager, "IIR Filter") {}
 
 std::vector<double> IIRfilterPlugin::getIIRfilterNumeratorCoefficients()
@@ -402,6 +622,61 @@ std::vector<double> IIRfilterPlugin::getIIRfilterDenominatorCoefficients()
 	return dynamic_cast<IIRfilterComponent*>(this->getComponent())->getDenominatorCoefficients();
 }
 
+LatencyReport IIRfilterPlugin::getIIRfilterLatency()
+{
+	return dynamic_cast<IIRfilterComponent*>(this->getComponent())->getLatency();
+}
+
+std::vector<ImplementationTiming> IIRfilterPlugin::getIIRfilterTiming()
+{
+	return dynamic_cast<IIRfilterComponent*>(this->getComponent())->getTiming();
+}
+
+precision_t IIRfilterPlugin::getIIRfilterPrecision()
+{
+	return dynamic_cast<IIRfilterComponent*>(this->getComponent())->getPrecision();
+}
+
+CoefficientFile IIRfilterPlugin::getIIRfilterCoefficients(bool with_state)
+{
+	return dynamic_cast<IIRfilterComponent*>(this->getComponent())->exportCoefficients(with_state);
+}
+
+void IIRfilterPlugin::installIIRfilterCoefficients(CoefficientFile file)
+{
+	dynamic_cast<IIRfilterComponent*>(this->getComponent())->installCoefficients(std::move(file));
+}
+
+bool IIRfilterPlugin::startIIRfilterStream(const std::string& path, std::string& error)
+{
+	return dynamic_cast<IIRfilterComponent*>(this->getComponent())->startStream(path, error);
+}
+
+void IIRfilterPlugin::stopIIRfilterStream()
+{
+	dynamic_cast<IIRfilterComponent*>(this->getComponent())->stopStream();
+}
+
+StreamReport IIRfilterPlugin::getIIRfilterStream()
+{
+	return dynamic_cast<IIRfilterComponent*>(this->getComponent())->getStream();
+}
+
+HealthReport IIRfilterPlugin::getIIRfilterHealth()
+{
+	return dynamic_cast<IIRfilterComponent*>(this->getComponent())->getHealth();
+}
+
+AutoOrderReport IIRfilterPlugin::getIIRfilterAutoOrder()
+{
+	return dynamic_cast<IIRfilterComponent*>(this->getComponent())->getAutoOrder();
+}
+
+std::shared_ptr<const FrequencyResponse> IIRfilterPlugin::getIIRfilterResponse()
+{
+	return dynamic_cast<IIRfilterComponent*>(this->getComponent())->getResponse();
+}
+
 //create plug-in
 std::unique_ptr<Widgets::Plugin> createRTXIPlugin(Event::Manager* ev_manager)
 {
@@ -417,7 +692,7 @@ Widgets::Panel* createRTXIPanel(QMainWindow* main_window,
 std::unique_ptr<Widgets::Component> createRTXIComponent(
     Widgets::Plugin* host_plugin)
 {
-  return std::make_unique<IIRfilterComponent>(host_plugin);
+  return std::make_unique<IIRfilterComponent>(host_plugin, IIR_FILTER_CHANNELS);
 }
 
 Widgets::FactoryMethods fact;
@@ -15,7 +15,6 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 */
-
 /*
 * Creates IIR filters
 * Butterworth: passband_edge
@@ -23,58 +22,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 * Elliptical: passband_ripple, stopband_ripple, passband_edge, stopband_edge
 */
 
+#include <memory>
+#include <QCheckBox>
 #include <QComboBox>
 #include <QFile>
+#include <QLabel>
 #include <QTextStream>
-#include <rtxi/dsp/iir_dsgn.h>
-#include <rtxi/dsp/dir1_iir.h>
-#include <rtxi/dsp/unq_iir.h>
-#include <rtxi/dsp/buttfunc.h>
-#include <rtxi/dsp/chebfunc.h>
-#include <rtxi/dsp/elipfunc.h>
-#include <rtxi/dsp/bilinear.h>
 #include <rtxi/widgets.hpp>
-
-#define TWO_PI 6.28318531
-
-class IIRfilterComponent : public Widgets::Component{
-	public:
-		explicit IIRfilterComponent(Widgets::Plugin* host_plugin);
-		void execute() override;
-		std::vector<double> getNumeratorCoefficients();
-		std::vector<double> getDenominatorCoefficients();
-	private:
-		enum filter_t : uint64_t {
-			BUTTER=0, CHEBY, ELLIP,
-		};
-		// filter parameters
-		FilterTransFunc *analog_filter=nullptr;
-		IirFilterDesign *filter_design=nullptr;
-		FilterImplementation *filter_implem=nullptr;
-
-		double h3; // filter coefficients
-		filter_t filter_type; // type of filter
-		double passband_ripple; // dB?
-		double stopband_ripple; // dB?
-		double passband_edge; // Hz
-		double stopband_edge; // Hz
-		int filter_order; // filter order
-		int ripple_bw_norm; // type of normalization for Chebyshev filter
-
-		bool quant_enabled; // quantize input signal and coefficients
-		bool predistort_enabled; // predistort frequencies for bilinear transform
-		int input_quan_factor; // quantization factor 2^bits for input signal
-		int coeff_quan_factor; // quantization factor 2^bits for filter coefficients
-
-		// bookkeeping
-		double out; // bookkeeping for computing convolution
-		int n; // bookkeeping for computing convolution
-		double dt; // real-time period of system (s)
-
-		// IIRfilter functions
-		void initParameters();
-		void makeFilter();
-};
+#include "component.hpp"
+#include "response-plot.hpp"
 
 class IIRfilter : public Widgets::Panel {
 	Q_OBJECT
@@ -87,6 +43,21 @@ class IIRfilter : public Widgets::Panel {
 
 		QComboBox *filterType;
 		QComboBox *normType;
+		QComboBox *implemType;
+		QComboBox *precisionType;
+		QLabel *latencyLabel;
+		QLabel *autoOrderLabel;
+		QLabel *timingLabel;
+		QLabel *precisionLabel;
+		QLabel *streamLabel;
+		QPushButton *streamButton;
+		QCheckBox *predistortCheckBox;
+		QCheckBox *quantizeCheckBox;
+		QCheckBox *autoOrderCheckBox;
+		QCheckBox *multirateCheckBox;
+		QCheckBox *interpolateCheckBox;
+		QCheckBox *saveStateCheckBox;
+		ResponsePlot *responsePlot;
 
 		// Saving FIR filter data to file without Data Recorder
 		bool OpenFile(QString);
@@ -96,10 +67,26 @@ class IIRfilter : public Widgets::Panel {
 	private slots:
 		// all custom slots
 		void saveIIRData(); // write filter parameters to a file
+		void loadIIRData(); // install a saved filter without designing it
 		void updateFilterType(int);
 		void updateNormType(int);
+		void updateImplemType(int);
+		void updatePrecisionType(int);
 		void togglePredistort(bool);
 		void toggleQuantize(bool);
+		void toggleLiveRetune(bool);
+		void toggleAutoOrder(bool);
+		void toggleMultirate(bool);
+		void toggleInterpolate(bool);
+		void refreshAutoOrder(); // show the type and order the search chose
+		void refreshResponse(); // plot the latest design's response
+		void refreshTiming(); // show what each implementation costs
+		void refreshPrecision(); // show the precision the filter runs in
+		void updateResponseView(int);
+		void refreshLatency(); // show the latest latency snapshot
+		void saveLatency(); // write the latency histograms to a file
+		void toggleStream(bool); // start or stop streaming inputs and outputs to a file
+		void refreshStream(); // show what the stream has written
 };
 
 class IIRfilterPlugin : public Widgets::Plugin
@@ -108,5 +95,16 @@ public:
 	explicit IIRfilterPlugin(Event::Manager* ev_manager);
 	std::vector<double> getIIRfilterNumeratorCoefficients();
 	std::vector<double> getIIRfilterDenominatorCoefficients();
+	LatencyReport getIIRfilterLatency();
+	HealthReport getIIRfilterHealth();
+	AutoOrderReport getIIRfilterAutoOrder();
+	std::shared_ptr<const FrequencyResponse> getIIRfilterResponse();
+	std::vector<ImplementationTiming> getIIRfilterTiming();
+	precision_t getIIRfilterPrecision();
+	CoefficientFile getIIRfilterCoefficients(bool with_state);
+	void installIIRfilterCoefficients(CoefficientFile file);
+	bool startIIRfilterStream(const std::string& path, std::string& error);
+	void stopIIRfilterStream();
+	StreamReport getIIRfilterStream();
 };
 